@@ -0,0 +1,1544 @@
+#include <hz/slab.hpp>
+#include <hz/tlsf.hpp>
+#include <hz/alloc_trace.hpp>
+#include <hz/spinlock.hpp>
+#include <hz/ticket_spinlock.hpp>
+#include <hz/mcs_spinlock.hpp>
+#include <hz/rw_spinlock.hpp>
+#include <hz/seqlock.hpp>
+#include <hz/mutex.hpp>
+#include <hz/cache_padded.hpp>
+#include <hz/epoch.hpp>
+#include <hz/hazard_pointer.hpp>
+#include <hz/spsc_ring.hpp>
+#include <hz/mpmc_queue.hpp>
+#include <hz/mpsc_queue.hpp>
+#include <hz/thread_pool.hpp>
+#include <hz/sharded_counter.hpp>
+#include <hz/flat_combining.hpp>
+#include <hz/concurrent_skip_list.hpp>
+#include <hz/rb_tree.hpp>
+#include <hz/double_list.hpp>
+#include <hz/vector.hpp>
+#include <hz/string.hpp>
+#include <hz/unordered_map.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+	using bench_clock = std::chrono::steady_clock;
+
+	uint64_t elapsed_ns(bench_clock::time_point start, bench_clock::time_point end) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	struct xorshift {
+		uint64_t next() {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		uint64_t state;
+	};
+
+	struct MallocArenaAllocator {
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr, size_t) {
+			free(ptr);
+		}
+	};
+
+	struct MallocAllocator {
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr) {
+			free(ptr);
+		}
+	};
+
+	// Arena allocator keeping track of the bytes currently reserved from the system.
+	struct CountingArenaAllocator {
+		void* allocate(size_t size) {
+			reserved->current += size;
+			reserved->peak = std::max(reserved->peak, reserved->current);
+			return malloc(size);
+		}
+
+		void deallocate(void* ptr, size_t size) {
+			reserved->current -= size;
+			free(ptr);
+		}
+
+		struct Reserved {
+			size_t current;
+			size_t peak;
+		};
+
+		Reserved* reserved;
+	};
+
+	void print_latencies(const char* name, std::vector<uint64_t>& samples) {
+		std::sort(samples.begin(), samples.end());
+		uint64_t total = 0;
+		for (auto sample : samples) {
+			total += sample;
+		}
+		auto percentile = [&](double p) {
+			return samples[static_cast<size_t>(p * static_cast<double>(samples.size() - 1))];
+		};
+		printf("  %-24s avg %6lu ns  p99 %6lu ns  p99.99 %8lu ns  max %8lu ns\n",
+			name,
+			static_cast<unsigned long>(total / samples.size()),
+			static_cast<unsigned long>(percentile(0.99)),
+			static_cast<unsigned long>(percentile(0.9999)),
+			static_cast<unsigned long>(samples.back()));
+	}
+
+	// Random alloc/free churn over a fixed number of live slots, timing every single operation.
+	template<typename Alloc, typename Free>
+	void measure_latency(const char* name, size_t max_size, Alloc alloc, Free free) {
+		constexpr size_t SLOTS = 1024;
+		constexpr size_t OPS = 1000000;
+
+		void* slots[SLOTS] {};
+		std::vector<uint64_t> alloc_samples;
+		std::vector<uint64_t> free_samples;
+		alloc_samples.reserve(OPS);
+		free_samples.reserve(OPS);
+
+		xorshift rng {0x9E3779B97F4A7C15};
+		for (size_t i = 0; i < OPS; ++i) {
+			auto& slot = slots[rng.next() % SLOTS];
+			if (slot) {
+				auto start = bench_clock::now();
+				free(slot);
+				free_samples.push_back(elapsed_ns(start, bench_clock::now()));
+				slot = nullptr;
+			}
+			else {
+				auto size = 1 + rng.next() % max_size;
+				auto start = bench_clock::now();
+				slot = alloc(size);
+				alloc_samples.push_back(elapsed_ns(start, bench_clock::now()));
+			}
+		}
+
+		for (auto* ptr : slots) {
+			if (ptr) {
+				free(ptr);
+			}
+		}
+
+		printf("%s\n", name);
+		print_latencies("alloc", alloc_samples);
+		print_latencies("free", free_samples);
+	}
+
+	void bench_tlsf_latency() {
+		constexpr size_t POOL_SIZE = 64 * 1024 * 1024;
+		for (size_t max_size : {size_t {256}, size_t {4096}, size_t {64 * 1024}}) {
+			printf("-- sizes 1..%zu\n", max_size);
+
+			auto* pool = malloc(POOL_SIZE);
+			// fault the pool in up front, a real-time user would do the same
+			memset(pool, 0, POOL_SIZE);
+			{
+				hz::tlsf_allocator tlsf {pool, POOL_SIZE};
+				measure_latency("tlsf_allocator", max_size, [&](size_t size) {
+					return tlsf.alloc(size);
+				}, [&](void* ptr) {
+					tlsf.free(ptr);
+				});
+			}
+			free(pool);
+
+			hz::slab_allocator<MallocArenaAllocator> slab {MallocArenaAllocator {}};
+			measure_latency("slab_allocator", max_size, [&](size_t size) {
+				return slab.alloc(size);
+			}, [&](void* ptr) {
+				slab.free(ptr);
+			});
+		}
+	}
+
+	struct VectorSink {
+		void write(const void* data, size_t size) {
+			auto* bytes = static_cast<const uint8_t*>(data);
+			log->insert(log->end(), bytes, bytes + size);
+		}
+
+		std::vector<uint8_t>* log;
+	};
+
+	// Container churn standing in for a production trace when none is given.
+	std::vector<uint8_t> record_synthetic_trace() {
+		std::vector<uint8_t> log;
+		{
+			hz::alloc_tracer<VectorSink, hz::hosted_alloc_trace_env> tracer {VectorSink {&log}};
+			using TracingAllocator = hz::tracing_allocator<MallocAllocator, decltype(tracer)>;
+			TracingAllocator alloc {MallocAllocator {}, &tracer};
+
+			xorshift rng {0xC0FFEE};
+			hz::unordered_map<int, hz::string<TracingAllocator>, TracingAllocator> map {alloc};
+			std::vector<hz::vector<int, TracingAllocator>> vectors;
+			for (int i = 0; i < 20000; ++i) {
+				auto key = static_cast<int>(rng.next() % 2048);
+				if (rng.next() % 4 == 0) {
+					map.remove(key);
+				}
+				else {
+					hz::string<TracingAllocator> str {alloc};
+					str.resize(rng.next() % 200, 'x');
+					map.insert(key, std::move(str));
+				}
+
+				if (vectors.size() < 256 || rng.next() % 2) {
+					hz::vector<int, TracingAllocator> vec {alloc};
+					auto count = rng.next() % (rng.next() % 16 == 0 ? 8192 : 64);
+					for (size_t j = 0; j < count; ++j) {
+						vec.push_back(static_cast<int>(j));
+					}
+					vectors.push_back(std::move(vec));
+				}
+				else {
+					vectors.erase(vectors.begin() + static_cast<ptrdiff_t>(rng.next() % vectors.size()));
+				}
+			}
+		}
+		return log;
+	}
+
+	std::vector<uint8_t> read_file(const char* path) {
+		std::vector<uint8_t> data;
+		auto* file = fopen(path, "rb");
+		if (!file) {
+			return data;
+		}
+		uint8_t buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file))) {
+			data.insert(data.end(), buffer, buffer + count);
+		}
+		fclose(file);
+		return data;
+	}
+
+	struct ReplayOp {
+		hz::alloc_trace_op op;
+		uint32_t slot;
+		size_t size;
+	};
+
+	// Resolves the traced pointers to dense slot indices up front so the replay itself only indexes arrays.
+	std::vector<ReplayOp> decode_trace(const std::vector<uint8_t>& log, size_t& slot_count) {
+		std::vector<ReplayOp> ops;
+		std::unordered_map<uintptr_t, uint32_t> live;
+		std::vector<uint32_t> free_slots;
+		slot_count = 0;
+
+		hz::alloc_trace_reader reader {log.data(), log.size()};
+		hz::alloc_trace_event event {};
+		while (reader.next(event)) {
+			if (event.op == hz::alloc_trace_op::alloc) {
+				uint32_t slot;
+				if (!free_slots.empty()) {
+					slot = free_slots.back();
+					free_slots.pop_back();
+				}
+				else {
+					slot = static_cast<uint32_t>(slot_count++);
+				}
+				live[event.ptr] = slot;
+				ops.push_back({event.op, slot, event.size});
+			}
+			else {
+				auto iter = live.find(event.ptr);
+				// allocations made before tracing started can't be replayed
+				if (iter == live.end()) {
+					continue;
+				}
+				ops.push_back({event.op, iter->second, 0});
+				free_slots.push_back(iter->second);
+				live.erase(iter);
+			}
+		}
+		return ops;
+	}
+
+	template<typename Alloc, typename Free, typename Reserved>
+	void replay_trace(const char* name, const std::vector<ReplayOp>& ops, size_t slot_count, Alloc alloc, Free free, Reserved reserved) {
+		constexpr size_t SAMPLES = 10;
+
+		std::vector<void*> ptrs(slot_count);
+		std::vector<size_t> sizes(slot_count);
+		size_t live_bytes = 0;
+		size_t peak_live_bytes = 0;
+
+		printf("%s\n", name);
+
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < ops.size(); ++i) {
+			const auto& op = ops[i];
+			if (op.op == hz::alloc_trace_op::alloc) {
+				ptrs[op.slot] = alloc(op.size);
+				sizes[op.slot] = op.size;
+				live_bytes += op.size;
+				peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+			}
+			else {
+				free(ptrs[op.slot]);
+				ptrs[op.slot] = nullptr;
+				live_bytes -= sizes[op.slot];
+			}
+
+			if ((i + 1) % (ops.size() / SAMPLES + 1) == 0) {
+				auto current = reserved().current;
+				printf("  %3zu%%  live %10zu B  reserved %10zu B  fragmentation %5.1f%%\n",
+					(i + 1) * 100 / ops.size(), live_bytes, current,
+					current ? 100.0 * static_cast<double>(current - live_bytes) / static_cast<double>(current) : 0.0);
+			}
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+
+		for (size_t i = 0; i < slot_count; ++i) {
+			if (ptrs[i]) {
+				free(ptrs[i]);
+			}
+		}
+
+		printf("  %.2f Mops/s, peak live %zu B, peak reserved %zu B\n",
+			static_cast<double>(ops.size()) * 1000.0 / static_cast<double>(ns), peak_live_bytes, reserved().peak);
+	}
+
+	// Replays the trace given in HZ_ALLOC_TRACE (recorded with hz::alloc_tracer) or a synthetic one.
+	// Threads are replayed in the recorded global order on a single thread.
+	void bench_trace_replay() {
+		std::vector<uint8_t> log;
+		if (auto* path = getenv("HZ_ALLOC_TRACE")) {
+			log = read_file(path);
+			printf("trace %s, %zu bytes\n", path, log.size());
+		}
+		else {
+			log = record_synthetic_trace();
+			printf("synthetic trace, %zu bytes\n", log.size());
+		}
+
+		size_t slot_count;
+		auto ops = decode_trace(log, slot_count);
+		printf("%zu events, %zu bytes per event\n", ops.size(), ops.empty() ? 0 : log.size() / ops.size());
+		if (ops.empty()) {
+			return;
+		}
+
+		CountingArenaAllocator::Reserved slab_reserved {};
+		{
+			hz::slab_allocator<CountingArenaAllocator> slab {CountingArenaAllocator {&slab_reserved}};
+			replay_trace("slab_allocator<default_slab_config>", ops, slot_count, [&](size_t size) {
+				return slab.alloc(size);
+			}, [&](void* ptr) {
+				slab.free(ptr);
+			}, [&]() {
+				return slab_reserved;
+			});
+		}
+	}
+
+	template<typename Slab, bool AtLeast>
+	struct SlabRef {
+		void* allocate(size_t size) {
+			++*allocations;
+			return slab->alloc(size);
+		}
+
+		hz::allocation_result allocate_at_least(size_t size) requires AtLeast {
+			++*allocations;
+			return slab->alloc_at_least(size);
+		}
+
+		void deallocate(void* ptr) {
+			slab->free(ptr);
+		}
+
+		Slab* slab;
+		size_t* allocations;
+	};
+
+	// Appending to many short vectors and strings, with and without allocate_at_least.
+	void bench_vector_append() {
+		using Slab = hz::slab_allocator<MallocArenaAllocator>;
+		Slab slab {MallocArenaAllocator {}};
+
+		auto run = [&]<typename Alloc>(const char* name, Alloc alloc) {
+			auto start = bench_clock::now();
+			for (int i = 0; i < 10000; ++i) {
+				hz::vector<uint16_t, Alloc> vec {alloc};
+				for (int j = 0; j < i % 1000; ++j) {
+					vec.push_back(static_cast<uint16_t>(j));
+				}
+				hz::string<Alloc> str {alloc};
+				for (int j = 0; j < i % 500; ++j) {
+					str += 'a';
+				}
+			}
+			auto ns = elapsed_ns(start, bench_clock::now());
+			printf("  %-24s %8zu allocations  %8.2f ms\n", name, *alloc.allocations, static_cast<double>(ns) / 1000000.0);
+		};
+
+		size_t allocations = 0;
+		run("allocate", SlabRef<Slab, false> {&slab, &allocations});
+		allocations = 0;
+		run("allocate_at_least", SlabRef<Slab, true> {&slab, &allocations});
+	}
+
+	// Every thread repeatedly takes the lock for a short critical section until the time is up.
+	// Fairness is the ratio between the least and the most acquisitions done by a single thread.
+	template<typename Lock>
+	void run_lock_contention(const char* name, size_t thread_count) {
+		Lock lock {};
+		std::atomic<bool> start {};
+		std::atomic<bool> stop {};
+		std::vector<uint64_t> counts(thread_count);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				while (!start.load(std::memory_order_acquire));
+				uint64_t count = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					auto guard = lock.lock();
+					++*guard;
+					++count;
+				}
+				counts[i] = count;
+			});
+		}
+
+		auto begin = bench_clock::now();
+		start.store(true, std::memory_order_release);
+		std::this_thread::sleep_for(std::chrono::milliseconds {200});
+		stop.store(true, std::memory_order_relaxed);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(begin, bench_clock::now());
+
+		uint64_t total = 0;
+		for (auto count : counts) {
+			total += count;
+		}
+		auto [min, max] = std::minmax_element(counts.begin(), counts.end());
+		printf(
+			"  %-20s %3zu threads  %8.2f Mops/s  fairness %.2f\n",
+			name,
+			thread_count,
+			static_cast<double>(total) * 1000.0 / static_cast<double>(ns),
+			static_cast<double>(*min) / static_cast<double>(*max));
+	}
+
+	void bench_lock_contention() {
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			run_lock_contention<hz::spinlock<uint64_t>>("spinlock", threads);
+			run_lock_contention<hz::spinlock<uint64_t, hz::exponential_backoff<>>>("spinlock<exp>", threads);
+			run_lock_contention<hz::spinlock<uint64_t, hz::exponential_backoff<1, 1024, hz::thread_yield>>>(
+				"spinlock<exp+yield>",
+				threads);
+			run_lock_contention<hz::ticket_spinlock<uint64_t>>("ticket_spinlock", threads);
+			run_lock_contention<hz::mcs_spinlock<uint64_t>>("mcs_spinlock", threads);
+		}
+	}
+
+	using RouteMap = hz::unordered_map<uint64_t, uint64_t, MallocAllocator>;
+
+	// Lookups in a shared map with one write per 1000 operations.
+	template<typename Lock, typename Read>
+	void run_read_mostly(const char* name, size_t thread_count, Read read) {
+		Lock lock {RouteMap {MallocAllocator {}}};
+		{
+			auto guard = lock.lock();
+			for (uint64_t i = 0; i < 1024; ++i) {
+				guard->insert(i, i);
+			}
+		}
+
+		constexpr size_t OPS = 1000000;
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				xorshift rng {i + 1};
+				uint64_t sum = 0;
+				for (size_t j = 0; j < OPS / thread_count; ++j) {
+					auto key = rng.next() % 1024;
+					if (j % 1000 == 0) {
+						auto guard = lock.lock();
+						guard->insert(key, j);
+					}
+					else {
+						sum += read(lock, key);
+					}
+				}
+				asm volatile("" : : "r"(sum));
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %3zu threads  %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<double>(OPS) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_read_mostly() {
+		auto exclusive_read = [](auto& lock, uint64_t key) {
+			auto guard = lock.lock();
+			return *guard->get(key);
+		};
+		auto shared_read = [](auto& lock, uint64_t key) {
+			auto guard = lock.lock_shared();
+			return *guard->get(key);
+		};
+
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			run_read_mostly<hz::spinlock<RouteMap>>("spinlock", threads, exclusive_read);
+			run_read_mostly<hz::rw_spinlock<RouteMap>>("rw_spinlock", threads, shared_read);
+			run_read_mostly<hz::rw_spinlock<RouteMap, 16>>("rw_spinlock<16>", threads, shared_read);
+		}
+	}
+
+	struct Snapshot {
+		uint64_t mult;
+		uint64_t shift;
+		uint64_t offset;
+	};
+
+	// Readers copy a small snapshot as fast as they can while one extra thread rewrites it every 10us.
+	template<typename Read, typename Write>
+	void run_snapshot_reads(const char* name, size_t reader_count, Read read, Write write) {
+		std::atomic<bool> stop {};
+		std::vector<uint64_t> counts(reader_count);
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < reader_count; ++i) {
+			threads.emplace_back([&, i] {
+				uint64_t count = 0;
+				uint64_t sum = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					auto snapshot = read();
+					sum += snapshot.mult + snapshot.offset;
+					++count;
+				}
+				asm volatile("" : : "r"(sum));
+				counts[i] = count;
+			});
+		}
+		std::thread writer {[&] {
+			for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+				write(Snapshot {i, i, i});
+				std::this_thread::sleep_for(std::chrono::microseconds {10});
+			}
+		}};
+
+		std::this_thread::sleep_for(std::chrono::milliseconds {200});
+		stop.store(true, std::memory_order_relaxed);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		writer.join();
+		auto ns = elapsed_ns(start, bench_clock::now());
+
+		uint64_t total = 0;
+		for (auto count : counts) {
+			total += count;
+		}
+		printf(
+			"  %-10s %3zu readers  %8.2f Mreads/s\n",
+			name,
+			reader_count,
+			static_cast<double>(total) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_seqlock_read() {
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t readers = 1; readers <= max_threads; readers *= 2) {
+			hz::spinlock<Snapshot> spin {};
+			run_snapshot_reads(
+				"spinlock",
+				readers,
+				[&] {
+					return *spin.lock();
+				},
+				[&](const Snapshot& snapshot) {
+					*spin.lock() = snapshot;
+				});
+
+			hz::seqlock<Snapshot> seq {};
+			run_snapshot_reads(
+				"seqlock",
+				readers,
+				[&] {
+					return seq.read();
+				},
+				[&](const Snapshot& snapshot) {
+					seq.write(snapshot);
+				});
+		}
+	}
+
+	uint64_t process_cpu_ns() {
+		timespec ts {};
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+		return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+	}
+
+	// Four threads per cpu each run a fixed number of critical sections of a few hundred
+	// nanoseconds, so lock holders regularly get preempted while others wait.
+	template<typename Lock>
+	void run_oversubscribed(const char* name, size_t thread_count) {
+		constexpr size_t OPS = 200000;
+		Lock lock {};
+		std::vector<std::thread> threads;
+		auto cpu_start = process_cpu_ns();
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&] {
+				for (size_t j = 0; j < OPS / thread_count; ++j) {
+					auto guard = lock.lock();
+					for (int k = 0; k < 100; ++k) {
+						*guard = *guard * 6364136223846793005 + 1;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		auto cpu_ns = process_cpu_ns() - cpu_start;
+		printf(
+			"  %-10s %3zu threads  wall %8.2f ms  cpu %8.2f ms\n",
+			name,
+			thread_count,
+			static_cast<double>(ns) / 1000000.0,
+			static_cast<double>(cpu_ns) / 1000000.0);
+	}
+
+	void bench_oversubscription() {
+		size_t thread_count = std::max(std::thread::hardware_concurrency(), 1U) * 4;
+		run_oversubscribed<hz::spinlock<uint64_t>>("spinlock", thread_count);
+		run_oversubscribed<hz::mutex<uint64_t>>("mutex", thread_count);
+	}
+
+	// Every thread only uses the lock at its own index, so any slowdown comes from false sharing.
+	template<typename Slot>
+	void run_lock_array(const char* name, size_t thread_count) {
+		constexpr size_t OPS = 2000000;
+		std::vector<Slot> locks(thread_count);
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				auto& lock = locks[i];
+				for (size_t j = 0; j < OPS; ++j) {
+					auto guard = (*lock).lock();
+					++*guard;
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %3zu threads  %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<double>(OPS * thread_count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	struct PackedLock {
+		hz::spinlock<uint64_t>& operator*() {
+			return lock;
+		}
+
+		hz::spinlock<uint64_t> lock;
+	};
+
+	// every thread allocates from its own size class, with or without a thread cache
+	template<bool Cached>
+	void run_slab_size_classes(const char* name, size_t thread_count) {
+		constexpr size_t SIZES[] {16, 32, 64, 128, 256, 512, 1024, 2048};
+		constexpr size_t OPS = 1000000;
+		using Slab = hz::slab_allocator<MallocArenaAllocator>;
+		Slab slab {MallocArenaAllocator {}};
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				Slab::thread_cache cache {slab};
+				void* ptrs[16];
+				for (size_t j = 0; j < OPS / 16; ++j) {
+					for (auto& ptr : ptrs) {
+						if constexpr (Cached) {
+							ptr = slab.alloc(SIZES[i % std::size(SIZES)], cache);
+						}
+						else {
+							ptr = slab.alloc(SIZES[i % std::size(SIZES)]);
+						}
+					}
+					for (auto* ptr : ptrs) {
+						if constexpr (Cached) {
+							slab.free(ptr, cache);
+						}
+						else {
+							slab.free(ptr);
+						}
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %3zu threads  %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<double>(OPS * thread_count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_size_classes() {
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			run_lock_array<PackedLock>("packed locks", threads);
+			run_lock_array<hz::cache_padded<hz::spinlock<uint64_t>>>("cache_padded locks", threads);
+		}
+
+		for (size_t threads = 1; threads <= std::min<size_t>(max_threads, 8); threads *= 2) {
+			run_slab_size_classes<false>("slab size classes", threads);
+			run_slab_size_classes<true>("slab thread cache", threads);
+		}
+	}
+
+	// Cost of protecting a single pointer read with the different read side mechanisms.
+	template<typename Read>
+	void run_read_side(const char* name, size_t thread_count, Read read) {
+		constexpr size_t OPS = 10000000;
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&] {
+				read(OPS / thread_count);
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-16s %3zu threads  %6.2f ns/read\n",
+			name,
+			thread_count,
+			static_cast<double>(ns) * static_cast<double>(thread_count) / static_cast<double>(OPS));
+	}
+
+	void bench_epoch_read() {
+		uint64_t object = 1;
+		hz::atomic<uint64_t*> shared {&object};
+		hz::epoch_domain domain {};
+		hz::spinlock<uint64_t*> spin {&object};
+		hz::rw_spinlock<uint64_t*> rw {&object};
+
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			run_read_side("unprotected", threads, [&](size_t count) {
+				uint64_t sum = 0;
+				for (size_t i = 0; i < count; ++i) {
+					sum += *shared.load(hz::memory_order::acquire);
+				}
+				asm volatile("" : : "r"(sum));
+			});
+			run_read_side("epoch pin", threads, [&](size_t count) {
+				hz::epoch_domain::thread_record record {domain};
+				uint64_t sum = 0;
+				for (size_t i = 0; i < count; ++i) {
+					auto guard = record.pin();
+					sum += *shared.load(hz::memory_order::acquire);
+				}
+				asm volatile("" : : "r"(sum));
+			});
+			run_read_side("rw_spinlock", threads, [&](size_t count) {
+				uint64_t sum = 0;
+				for (size_t i = 0; i < count; ++i) {
+					sum += **rw.lock_shared();
+				}
+				asm volatile("" : : "r"(sum));
+			});
+			run_read_side("spinlock", threads, [&](size_t count) {
+				uint64_t sum = 0;
+				for (size_t i = 0; i < count; ++i) {
+					sum += **spin.lock();
+				}
+				asm volatile("" : : "r"(sum));
+			});
+		}
+	}
+
+	struct StackNode : hz::hazard_hook, hz::epoch_hook {
+		uint64_t value;
+		StackNode* next_node;
+	};
+
+	// Treiber stack whose popped nodes are reclaimed through hazard pointers.
+	class HazardStack {
+	public:
+		using Domain = hz::hazard_domain<1>;
+
+		void push(uint64_t value) {
+			auto* node = new StackNode {{}, {}, value, head.load(hz::memory_order::relaxed)};
+			while (!head.compare_exchange_weak(node->next_node, node, hz::memory_order::release, hz::memory_order::relaxed));
+		}
+
+		bool pop(Domain::thread_record& record) {
+			while (true) {
+				auto* node = record.protect(0, head);
+				if (!node) {
+					return false;
+				}
+				if (head.compare_exchange_strong(node, node->next_node, hz::memory_order::acquire, hz::memory_order::relaxed)) {
+					record.reset(0);
+					record.retire(node, [](hz::hazard_hook* hook, void*) {
+						delete static_cast<StackNode*>(hook);
+					});
+					return true;
+				}
+			}
+		}
+
+		Domain domain {nullptr, 64};
+		hz::atomic<StackNode*> head {};
+	};
+
+	class SpinlockStack {
+	public:
+		void push(uint64_t value) {
+			auto* node = new StackNode {{}, {}, value, nullptr};
+			auto guard = head.lock();
+			node->next_node = *guard;
+			*guard = node;
+		}
+
+		bool pop() {
+			StackNode* node;
+			{
+				auto guard = head.lock();
+				node = *guard;
+				if (!node) {
+					return false;
+				}
+				*guard = node->next_node;
+			}
+			delete node;
+			return true;
+		}
+
+		hz::spinlock<StackNode*> head {};
+	};
+
+	template<typename Op>
+	void run_stack(const char* name, size_t thread_count, Op op) {
+		constexpr size_t OPS = 1000000;
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				op(i, OPS / thread_count);
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-24s %3zu threads  %6.2f ns/op",
+			name,
+			thread_count,
+			static_cast<double>(ns) * static_cast<double>(thread_count) / static_cast<double>(OPS * 2));
+	}
+
+	void bench_hazard_stack() {
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			SpinlockStack spin_stack;
+			run_stack("spinlock stack", threads, [&](size_t, size_t count) {
+				for (size_t i = 0; i < count; ++i) {
+					spin_stack.push(i);
+					spin_stack.pop();
+				}
+			});
+			printf("\n");
+
+			HazardStack stack;
+			std::atomic<size_t> peak {};
+			run_stack("hazard pointer stack", threads, [&](size_t index, size_t count) {
+				HazardStack::Domain::thread_record record {stack.domain};
+				for (size_t i = 0; i < count; ++i) {
+					stack.push(i);
+					stack.pop(record);
+					if (index == 0) {
+						peak.store(std::max(peak.load(std::memory_order_relaxed), stack.domain.get_unreclaimed()), std::memory_order_relaxed);
+					}
+				}
+			});
+			printf("  peak unreclaimed %zu\n", peak.load());
+		}
+
+		// a reader that stalls while protecting a node only keeps that node alive with hazard pointers,
+		// while with epochs it blocks every reclamation until it unpins
+		HazardStack stack;
+		stack.push(0);
+		size_t epoch_reclaimed = 0;
+		hz::epoch_domain epochs {&epoch_reclaimed};
+		std::atomic<bool> stalled {};
+		std::atomic<bool> done {};
+		std::thread reader {[&] {
+			HazardStack::Domain::thread_record record {stack.domain};
+			hz::epoch_domain::thread_record epoch_record {epochs};
+			record.protect(0, stack.head);
+			auto guard = epoch_record.pin();
+			stalled.store(true);
+			while (!done.load()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds {1});
+			}
+		}};
+		while (!stalled.load()) {
+			std::this_thread::yield();
+		}
+
+		{
+			HazardStack::Domain::thread_record record {stack.domain};
+			hz::epoch_domain::thread_record epoch_record {epochs};
+			size_t hazard_peak = 0;
+			for (size_t i = 0; i < 100000; ++i) {
+				stack.push(i);
+				stack.pop(record);
+				hazard_peak = std::max(hazard_peak, stack.domain.get_unreclaimed());
+
+				auto* node = new StackNode {{}, {}, i, nullptr};
+				epoch_record.retire(node, [](hz::epoch_hook* hook, void* context) {
+					++*static_cast<size_t*>(context);
+					delete static_cast<StackNode*>(hook);
+				});
+			}
+			printf(
+				"  stalled reader: hazard pointer peak unreclaimed %zu, epoch unreclaimed %zu\n",
+				hazard_peak,
+				100000 - epoch_reclaimed);
+			done.store(true);
+			reader.join();
+		}
+		epochs.drain();
+		stack.domain.drain();
+		while (stack.head.load(hz::memory_order::relaxed)) {
+			HazardStack::Domain::thread_record record {stack.domain};
+			stack.pop(record);
+		}
+	}
+
+	void pin_to_cpu(std::thread& thread, size_t cpu) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu % std::max(std::thread::hardware_concurrency(), 1U), &set);
+		pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+	}
+
+	// The producer is pinned to cpu 0 and the consumer to cpu 1.
+	template<typename Produce, typename Consume>
+	void run_handoff(const char* name, size_t count, Produce produce, Consume consume) {
+		auto start = bench_clock::now();
+		std::thread consumer {[&] {
+			consume(count);
+		}};
+		std::thread producer {[&] {
+			produce(count);
+		}};
+		pin_to_cpu(producer, 0);
+		pin_to_cpu(consumer, 1);
+		producer.join();
+		consumer.join();
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf("  %-20s %8.2f Mitems/s\n", name, static_cast<double>(count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_spsc_ring() {
+		if (std::thread::hardware_concurrency() < 2) {
+			printf("  needs at least 2 cpus\n");
+			return;
+		}
+
+		constexpr size_t COUNT = 10000000;
+
+		auto ring = std::make_unique<hz::spsc_ring<uint64_t, 1024>>();
+		run_handoff(
+			"spsc_ring",
+			COUNT,
+			[&](size_t count) {
+				for (uint64_t i = 0; i < count; ++i) {
+					while (!ring->try_push(i));
+				}
+			},
+			[&](size_t count) {
+				for (size_t i = 0; i < count;) {
+					if (ring->try_pop()) {
+						++i;
+					}
+				}
+			});
+
+		run_handoff(
+			"spsc_ring batch 32",
+			COUNT,
+			[&](size_t count) {
+				uint64_t values[32];
+				for (uint64_t i = 0; i < count;) {
+					size_t batch = std::min<size_t>(32, count - i);
+					for (size_t j = 0; j < batch; ++j) {
+						values[j] = i + j;
+					}
+					for (size_t pushed = 0; pushed < batch;) {
+						pushed += ring->push_batch(values + pushed, batch - pushed);
+					}
+					i += batch;
+				}
+			},
+			[&](size_t count) {
+				uint64_t values[32];
+				for (size_t i = 0; i < count;) {
+					i += ring->pop_batch(values, 32);
+				}
+			});
+
+		hz::spinlock<std::vector<uint64_t>> locked {};
+		run_handoff(
+			"spinlock<vector>",
+			COUNT,
+			[&](size_t count) {
+				for (uint64_t i = 0; i < count; ++i) {
+					locked.lock()->push_back(i);
+				}
+			},
+			[&](size_t count) {
+				std::vector<uint64_t> local;
+				for (size_t i = 0; i < count;) {
+					local.clear();
+					std::swap(local, *locked.lock());
+					i += local.size();
+				}
+			});
+
+		// round trip latency through a pair of rings
+		constexpr size_t ROUND_TRIPS = 1000000;
+		hz::spsc_ring<uint64_t, 64> ping;
+		hz::spsc_ring<uint64_t, 64> pong;
+		auto start = bench_clock::now();
+		std::thread echo {[&] {
+			for (size_t i = 0; i < ROUND_TRIPS; ++i) {
+				hz::optional<uint64_t> value;
+				while (!(value = ping.try_pop()));
+				while (!pong.try_push(*value));
+			}
+		}};
+		pin_to_cpu(echo, 1);
+		for (uint64_t i = 0; i < ROUND_TRIPS; ++i) {
+			while (!ping.try_push(i));
+			while (!pong.try_pop());
+		}
+		echo.join();
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf("  %-20s %8.2f ns\n", "round trip", static_cast<double>(ns) / static_cast<double>(ROUND_TRIPS));
+	}
+
+	struct QueueNode {
+		hz::list_hook hook;
+		uint64_t value;
+	};
+
+	// Runs producers and consumers unpinned, every producer pushes count / producers nodes
+	// and every consumer pops count / consumers of them.
+	template<typename Push, typename Pop>
+	void run_mpmc(const char* name, size_t producers, size_t consumers, size_t count, Push push, Pop pop) {
+		std::vector<QueueNode> nodes(count);
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < producers; ++i) {
+			threads.emplace_back([&, i] {
+				size_t per_thread = count / producers;
+				for (size_t j = i * per_thread; j < (i + 1) * per_thread; ++j) {
+					nodes[j].value = j;
+					push(&nodes[j]);
+				}
+			});
+		}
+		for (size_t i = 0; i < consumers; ++i) {
+			threads.emplace_back([&] {
+				for (size_t j = 0; j < count / consumers; ++j) {
+					pop();
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %zup %zuc %8.2f Mitems/s\n",
+			name,
+			producers,
+			consumers,
+			static_cast<double>(count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_mpmc_queue() {
+		constexpr size_t COUNT = 1 << 21;
+		constexpr size_t CAPACITY = 1024;
+
+		size_t max_threads = std::max<size_t>(std::thread::hardware_concurrency() / 2, 1);
+		for (size_t producers = 1; producers <= max_threads; producers *= 2) {
+			for (size_t consumers = 1; consumers <= max_threads; consumers *= 2) {
+				hz::mpmc_queue<QueueNode*, MallocAllocator> queue {CAPACITY, MallocAllocator {}};
+				run_mpmc(
+					"mpmc_queue",
+					producers,
+					consumers,
+					COUNT,
+					[&](QueueNode* node) {
+						while (!queue.try_push(node)) {
+							std::this_thread::yield();
+						}
+					},
+					[&] {
+						while (!queue.try_pop()) {
+							std::this_thread::yield();
+						}
+					});
+
+				hz::mpmc_queue<QueueNode*, MallocAllocator, true> blocking {CAPACITY, MallocAllocator {}};
+				run_mpmc(
+					"mpmc_queue blocking",
+					producers,
+					consumers,
+					COUNT,
+					[&](QueueNode* node) {
+						blocking.push(node);
+					},
+					[&] {
+						blocking.pop();
+					});
+
+				hz::spinlock<hz::list<QueueNode, &QueueNode::hook>> locked {};
+				run_mpmc(
+					"spinlock<list>",
+					producers,
+					consumers,
+					COUNT,
+					[&](QueueNode* node) {
+						locked.lock()->push(node);
+					},
+					[&] {
+						while (!locked.lock()->pop_front()) {
+							std::this_thread::yield();
+						}
+					});
+			}
+		}
+	}
+
+	void bench_mpsc_queue() {
+		constexpr size_t COUNT = 1 << 21;
+
+		size_t max_threads = std::max<size_t>(std::thread::hardware_concurrency() - 1, 1);
+		for (size_t producers = 1; producers <= max_threads; producers *= 2) {
+			hz::mpsc_queue<QueueNode, &QueueNode::hook> queue;
+			run_mpmc(
+				"mpsc_queue",
+				producers,
+				1,
+				COUNT,
+				[&](QueueNode* node) {
+					queue.push(node);
+				},
+				[&] {
+					while (!queue.pop()) {
+						std::this_thread::yield();
+					}
+				});
+
+			hz::spinlock<hz::list<QueueNode, &QueueNode::hook>> locked {};
+			run_mpmc(
+				"spinlock<list>",
+				producers,
+				1,
+				COUNT,
+				[&](QueueNode* node) {
+					locked.lock()->push(node);
+				},
+				[&] {
+					while (!locked.lock()->pop_front()) {
+						std::this_thread::yield();
+					}
+				});
+		}
+	}
+
+	void bench_thread_pool() {
+		constexpr size_t COUNT = 1 << 22;
+		auto storage = std::make_unique<uint64_t[]>(COUNT);
+		auto work = [out = storage.get()](size_t i) {
+			uint64_t x = i + 1;
+			for (int j = 0; j < 8; ++j) {
+				x = x * 6364136223846793005 + (x >> 29);
+			}
+			out[i] = x;
+		};
+
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < COUNT; ++i) {
+			work(i);
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf("  %-20s %8.2f Mitems/s\n", "serial", static_cast<double>(COUNT) * 1000.0 / static_cast<double>(ns));
+
+		size_t max_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			hz::thread_pool<MallocAllocator> pool {threads, MallocAllocator {}};
+			for (size_t grain : {16, 256, 4096}) {
+				start = bench_clock::now();
+				pool.parallel_for(0, COUNT, grain, work);
+				ns = elapsed_ns(start, bench_clock::now());
+				printf(
+					"  %-20s %2zut grain %-5zu %8.2f Mitems/s\n",
+					"parallel_for",
+					threads,
+					grain,
+					static_cast<double>(COUNT) * 1000.0 / static_cast<double>(ns));
+			}
+		}
+	}
+
+	// Every thread performs a fixed number of increments, reports the total rate.
+	template<typename Counter, typename Increment>
+	void run_counter(const char* name, size_t thread_count, Increment increment) {
+		constexpr size_t PER_THREAD = 2000000;
+
+		Counter counter {};
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&] {
+				for (size_t j = 0; j < PER_THREAD; ++j) {
+					increment(counter);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %2zut %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<double>(PER_THREAD * thread_count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_sharded_counter() {
+		auto atomic_increment = [](hz::atomic<uint64_t>& counter) {
+			counter.fetch_add(1, hz::memory_order::relaxed);
+		};
+		auto sharded_increment = [](auto& counter) {
+			counter.increment();
+		};
+
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U) * 2;
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			run_counter<hz::atomic<uint64_t>>("atomic", threads, atomic_increment);
+			run_counter<hz::sharded_counter<16>>("sharded_counter<16>", threads, sharded_increment);
+			run_counter<hz::sharded_counter<64>>("sharded_counter<64>", threads, sharded_increment);
+		}
+	}
+
+	struct TreeNode {
+		hz::rb_tree_hook hook;
+		uint64_t key;
+
+		constexpr std::strong_ordering operator<=>(const TreeNode& other) const {
+			return key <=> other.key;
+		}
+
+		constexpr bool operator==(const TreeNode& other) const {
+			return key == other.key;
+		}
+	};
+
+	using NodeTree = hz::rb_tree<TreeNode, &TreeNode::hook>;
+
+	// Every thread runs a 20% insert / 80% find mix on a shared tree, inserting nodes
+	// from its own preallocated range. Access is called once per thread with the benchmark body,
+	// which it calls with a function running an operation with exclusive access to the tree.
+	template<typename Access>
+	void run_tree_mix(const char* name, size_t thread_count, Access access) {
+		constexpr size_t OPS = 200000;
+		constexpr size_t INSERTS = OPS / 5;
+
+		auto nodes = std::make_unique<TreeNode[]>(thread_count * INSERTS);
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				access([&](auto&& run) {
+					xorshift rng {i + 1};
+					size_t inserted = 0;
+					uint64_t found = 0;
+					for (size_t j = 0; j < OPS; ++j) {
+						if (j % 5 == 0) {
+							auto* node = &nodes[i * INSERTS + inserted++];
+							node->key = rng.next();
+							run([node](NodeTree& tree) {
+								return tree.insert(node) ? 1 : 0;
+							});
+						}
+						else {
+							auto key = rng.next();
+							found += run([key](NodeTree& tree) {
+								return tree.find<uint64_t, &TreeNode::key>(key) ? 1 : 0;
+							});
+						}
+					}
+					asm volatile("" : : "r"(found));
+				});
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %2zut %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<double>(OPS * thread_count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_flat_combining() {
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U) * 2;
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			hz::spinlock<NodeTree> locked {};
+			run_tree_mix(
+				"spinlock<rb_tree>",
+				threads,
+				[&](auto body) {
+					body([&](auto op) {
+						auto guard = locked.lock();
+						return op(*guard);
+					});
+				});
+
+			hz::flat_combining<NodeTree> combined {};
+			run_tree_mix(
+				"flat_combining",
+				threads,
+				[&](auto body) {
+					hz::flat_combining<NodeTree>::thread_record record {combined};
+					body([&](auto op) {
+						return record.apply(op);
+					});
+				});
+		}
+	}
+
+	constexpr uint64_t ORDERED_KEYS = 1 << 16;
+
+	// Every thread runs find_percent lookups and splits the rest evenly between inserts and removes
+	// of random keys, the map starts half full. Access is called once per thread with the body,
+	// which it calls with an object providing insert, remove and find.
+	template<typename Access>
+	void run_ordered_mix(const char* name, size_t thread_count, uint64_t find_percent, Access access) {
+		constexpr size_t OPS = 200000;
+
+		access([](auto& map) {
+			for (uint64_t key = 0; key < ORDERED_KEYS; key += 2) {
+				map.insert(key);
+			}
+		});
+
+		std::vector<std::thread> threads;
+		auto start = bench_clock::now();
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				access([&](auto& map) {
+					xorshift rng {i + 1};
+					uint64_t found = 0;
+					for (size_t j = 0; j < OPS; ++j) {
+						auto value = rng.next();
+						auto key = (value >> 8) % ORDERED_KEYS;
+						auto op = value % 100;
+						if (op < find_percent) {
+							found += map.find(key);
+						}
+						else if ((op - find_percent) % 2) {
+							map.insert(key);
+						}
+						else {
+							map.remove(key);
+						}
+					}
+					asm volatile("" : : "r"(found));
+				});
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto ns = elapsed_ns(start, bench_clock::now());
+		printf(
+			"  %-20s %2zut %3zu%% find %8.2f Mops/s\n",
+			name,
+			thread_count,
+			static_cast<size_t>(find_percent),
+			static_cast<double>(OPS * thread_count) * 1000.0 / static_cast<double>(ns));
+	}
+
+	void bench_skip_list() {
+		using SkipList = hz::concurrent_skip_list<uint64_t, uint64_t, MallocAllocator>;
+
+		struct SkipListOps {
+			void insert(uint64_t key) {
+				list->insert(record, key, key);
+			}
+
+			void remove(uint64_t key) {
+				list->remove(record, key);
+			}
+
+			bool find(uint64_t key) {
+				return list->find(record, key).has_value();
+			}
+
+			SkipList* list;
+			SkipList::thread_record record;
+		};
+
+		struct TreeOps {
+			void insert(uint64_t key) {
+				auto* node = new TreeNode {{}, key};
+				if (!tree->lock()->insert(node)) {
+					delete node;
+				}
+			}
+
+			void remove(uint64_t key) {
+				TreeNode* node;
+				{
+					auto guard = tree->lock();
+					node = guard->find<uint64_t, &TreeNode::key>(key);
+					if (node) {
+						guard->remove(node);
+					}
+				}
+				delete node;
+			}
+
+			bool find(uint64_t key) {
+				return tree->lock()->find<uint64_t, &TreeNode::key>(key);
+			}
+
+			hz::spinlock<NodeTree>* tree;
+		};
+
+		size_t max_threads = std::max(std::thread::hardware_concurrency(), 2U) * 2;
+		for (uint64_t find_percent : {95, 50}) {
+			for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+				hz::spinlock<NodeTree> tree {};
+				run_ordered_mix("spinlock<rb_tree>", threads, find_percent, [&](auto body) {
+					TreeOps ops {&tree};
+					body(ops);
+				});
+				auto& remaining = tree.get_unsafe();
+				while (auto* node = remaining.get_first()) {
+					remaining.remove(node);
+					delete node;
+				}
+
+				SkipList list {MallocAllocator {}};
+				run_ordered_mix("concurrent_skip_list", threads, find_percent, [&](auto body) {
+					SkipListOps ops {&list, SkipList::thread_record {list}};
+					body(ops);
+				});
+			}
+		}
+	}
+
+	struct Benchmark {
+		const char* name;
+		void (*fn)();
+	};
+
+	constexpr Benchmark BENCHMARKS[] {
+		{"tlsf_latency", bench_tlsf_latency},
+		{"trace_replay", bench_trace_replay},
+		{"vector_append", bench_vector_append},
+		{"lock_contention", bench_lock_contention},
+		{"read_mostly", bench_read_mostly},
+		{"seqlock_read", bench_seqlock_read},
+		{"oversubscription", bench_oversubscription},
+		{"size_classes", bench_size_classes},
+		{"epoch_read", bench_epoch_read},
+		{"hazard_stack", bench_hazard_stack},
+		{"spsc_ring", bench_spsc_ring},
+		{"mpmc_queue", bench_mpmc_queue},
+		{"mpsc_queue", bench_mpsc_queue},
+		{"thread_pool", bench_thread_pool},
+		{"sharded_counter", bench_sharded_counter},
+		{"flat_combining", bench_flat_combining},
+		{"skip_list", bench_skip_list},
+	};
+}
+
+int main(int argc, char** argv) {
+	for (const auto& bench : BENCHMARKS) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i) {
+			if (strcmp(argv[i], bench.name) == 0) {
+				selected = true;
+				break;
+			}
+		}
+
+		if (selected) {
+			printf("== %s\n", bench.name);
+			bench.fn();
+		}
+	}
+}
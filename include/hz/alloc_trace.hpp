@@ -0,0 +1,263 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.hpp"
+#include "spinlock.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#include <time.h>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	enum class alloc_trace_op : uint8_t {
+		alloc,
+		free
+	};
+
+	struct alloc_trace_event {
+		alloc_trace_op op;
+		uint32_t thread;
+		uint64_t timestamp;
+		uintptr_t ptr;
+		// only valid for alloc events
+		size_t size;
+	};
+
+	template<typename T>
+	concept alloc_trace_sink = requires(T sink, const void* data, size_t size) {
+		sink.write(data, size);
+	};
+
+	template<typename T>
+	concept alloc_trace_env = requires(T) {
+		T::timestamp();
+		T::thread_id();
+	};
+
+#if __STDC_HOSTED__ == 1
+	struct hosted_alloc_trace_env {
+		static uint64_t timestamp() {
+			timespec ts {};
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+		}
+
+		static uint32_t thread_id() {
+			static atomic<uint32_t> next_id {};
+			thread_local uint32_t id = next_id.fetch_add(1, memory_order::relaxed);
+			return id;
+		}
+	};
+#endif
+
+	// Records allocation events into a compact binary log written to Sink in chunks.
+	// Every event is encoded as LEB128 varints:
+	// (thread << 1 | op), timestamp delta, zigzag encoded pointer delta and for allocations the size.
+	template<alloc_trace_sink Sink, alloc_trace_env Env>
+	class alloc_tracer {
+	public:
+		constexpr explicit alloc_tracer(Sink sink) : state {State {.sink {std::move(sink)}}} {}
+
+		alloc_tracer(const alloc_tracer&) = delete;
+		alloc_tracer& operator=(const alloc_tracer&) = delete;
+
+		~alloc_tracer() {
+			flush();
+		}
+
+		void record_alloc(void* ptr, size_t size) {
+			record(alloc_trace_op::alloc, ptr, size);
+		}
+
+		void record_free(void* ptr) {
+			record(alloc_trace_op::free, ptr, 0);
+		}
+
+		void flush() {
+			auto guard = state.lock();
+			if (guard->used) {
+				guard->sink.write(guard->buffer, guard->used);
+				guard->used = 0;
+			}
+		}
+
+	private:
+		static constexpr size_t BUFFER_SIZE = 4096;
+		// op + 4 varints of at most 10 bytes each
+		static constexpr size_t MAX_EVENT_SIZE = 1 + 4 * 10;
+
+		struct State {
+			Sink sink;
+			uint64_t last_timestamp {};
+			uintptr_t last_ptr {};
+			size_t used {};
+			uint8_t buffer[BUFFER_SIZE] {};
+		};
+
+		static size_t write_varint(uint8_t* out, uint64_t value) {
+			size_t count = 0;
+			while (value >= 0x80) {
+				out[count++] = static_cast<uint8_t>(value | 0x80);
+				value >>= 7;
+			}
+			out[count++] = static_cast<uint8_t>(value);
+			return count;
+		}
+
+		void record(alloc_trace_op op, void* ptr, size_t size) {
+			auto thread = Env::thread_id();
+
+			auto guard = state.lock();
+			if (BUFFER_SIZE - guard->used < MAX_EVENT_SIZE) {
+				guard->sink.write(guard->buffer, guard->used);
+				guard->used = 0;
+			}
+
+			// the timestamp is taken with the lock held so the deltas are never negative
+			uint64_t timestamp = Env::timestamp();
+			auto value = reinterpret_cast<uintptr_t>(ptr);
+			auto ptr_delta = static_cast<int64_t>(value - guard->last_ptr);
+
+			auto* out = guard->buffer + guard->used;
+			size_t used = write_varint(out, uint64_t {thread} << 1 | static_cast<uint64_t>(op));
+			used += write_varint(out + used, timestamp - guard->last_timestamp);
+			used += write_varint(out + used, static_cast<uint64_t>(ptr_delta << 1) ^ static_cast<uint64_t>(ptr_delta >> 63));
+			if (op == alloc_trace_op::alloc) {
+				used += write_varint(out + used, size);
+			}
+
+			guard->used += used;
+			guard->last_timestamp = timestamp;
+			guard->last_ptr = value;
+		}
+
+		spinlock<State> state;
+	};
+
+	// Decodes a log produced by alloc_tracer.
+	class alloc_trace_reader {
+	public:
+		constexpr alloc_trace_reader(const void* data, size_t size)
+			: ptr {static_cast<const uint8_t*>(data)}, end {static_cast<const uint8_t*>(data) + size} {}
+
+		// Returns false at the end of the log or if the last event is truncated.
+		constexpr bool next(alloc_trace_event& event) {
+			uint64_t header;
+			uint64_t timestamp_delta;
+			uint64_t ptr_delta;
+			if (!read_varint(header) || !read_varint(timestamp_delta) || !read_varint(ptr_delta)) {
+				return false;
+			}
+
+			event.op = static_cast<alloc_trace_op>(header & 1);
+			event.thread = static_cast<uint32_t>(header >> 1);
+
+			uint64_t size = 0;
+			if (event.op == alloc_trace_op::alloc && !read_varint(size)) {
+				return false;
+			}
+
+			last_timestamp += timestamp_delta;
+			last_ptr += static_cast<uintptr_t>((ptr_delta >> 1) ^ -(ptr_delta & 1));
+
+			event.timestamp = last_timestamp;
+			event.ptr = last_ptr;
+			event.size = size;
+			return true;
+		}
+
+	private:
+		constexpr bool read_varint(uint64_t& value) {
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (ptr == end) {
+					return false;
+				}
+				auto byte = *ptr++;
+				value |= uint64_t {byte & 0x7FU} << shift;
+				if (!(byte & 0x80)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		const uint8_t* ptr;
+		const uint8_t* end;
+		uint64_t last_timestamp {};
+		uintptr_t last_ptr {};
+	};
+
+	// Allocator wrapper forwarding to Inner and recording every allocation into a shared tracer.
+	// Events are recorded after allocating and before freeing, so a pointer can't be observed
+	// as reused before its free was recorded even with multiple threads.
+	// deallocate takes a size only if Inner does, so containers pick the same path as for Inner.
+	template<Allocator Inner, typename Tracer, bool Sized = SizedAllocator<Inner>>
+	class tracing_allocator {
+	public:
+		constexpr tracing_allocator(Inner inner, Tracer* tracer) : inner {std::move(inner)}, tracer {tracer} {}
+
+		void* allocate(size_t size) {
+			auto* ptr = inner.allocate(size);
+			if (ptr) {
+				tracer->record_alloc(ptr, size);
+			}
+			return ptr;
+		}
+
+		allocation_result allocate_at_least(size_t size) requires AtLeastAllocator<Inner> {
+			auto result = inner.allocate_at_least(size);
+			if (result.ptr) {
+				// the trace records what was asked for, replaying it must not inflate the sizes
+				tracer->record_alloc(result.ptr, size);
+			}
+			return result;
+		}
+
+		void deallocate(void* ptr, size_t size) {
+			if (ptr) {
+				tracer->record_free(ptr);
+			}
+			inner.deallocate(ptr, size);
+		}
+
+	private:
+		Inner inner;
+		Tracer* tracer;
+	};
+
+	template<Allocator Inner, typename Tracer>
+	class tracing_allocator<Inner, Tracer, false> {
+	public:
+		constexpr tracing_allocator(Inner inner, Tracer* tracer) : inner {std::move(inner)}, tracer {tracer} {}
+
+		void* allocate(size_t size) {
+			auto* ptr = inner.allocate(size);
+			if (ptr) {
+				tracer->record_alloc(ptr, size);
+			}
+			return ptr;
+		}
+
+		allocation_result allocate_at_least(size_t size) requires AtLeastAllocator<Inner> {
+			auto result = inner.allocate_at_least(size);
+			if (result.ptr) {
+				tracer->record_alloc(result.ptr, size);
+			}
+			return result;
+		}
+
+		void deallocate(void* ptr) {
+			if (ptr) {
+				tracer->record_free(ptr);
+			}
+			inner.deallocate(ptr);
+		}
+
+	private:
+		Inner inner;
+		Tracer* tracer;
+	};
+}
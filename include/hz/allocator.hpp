@@ -19,4 +19,16 @@ namespace hz {
 
 	template<typename T>
 	concept Allocator = UnsizedAllocator<T> || SizedAllocator<T>;
+
+	struct allocation_result {
+		void* ptr;
+		size_t count;
+	};
+
+	// Optional extension for allocators that can report the actual size of an allocation,
+	// count is the usable size in bytes which is at least the requested size.
+	template<typename T>
+	concept AtLeastAllocator = requires(remove_reference_t<T>& alloc, size_t size) {
+		{ alloc.allocate_at_least(size) } -> same_as<allocation_result>;
+	};
 }
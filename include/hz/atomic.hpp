@@ -1,6 +1,10 @@
 #pragma once
 #include "type_traits.hpp"
+#include "cpu_relax.hpp"
+#include "futex.hpp"
+#include "cache_padded.hpp"
 #include <stddef.h>
+#include <stdint.h>
 
 namespace hz {
 	enum class memory_order : int {
@@ -12,75 +16,308 @@ namespace hz {
 		seq_cst = __ATOMIC_SEQ_CST
 	};
 
-	template<typename T>
-	struct atomic {
-		using value_type = T;
+	inline void atomic_thread_fence(memory_order order) {
+		__atomic_thread_fence(static_cast<int>(order));
+	}
 
-		constexpr atomic() = default;
-		constexpr atomic(T desired) : value {desired} {} // NOLINT(*-explicit-constructor)
-		constexpr atomic(const atomic&) = delete;
+	namespace __detail {
+		struct alignas(hardware_destructive_interference_size) atomic_wait_slot {
+			// bumped on notify for addresses that can't be waited on directly
+			uint32_t epoch;
+			// threads currently blocked on an address hashed to this slot
+			uint32_t waiters;
+		};
 
-		constexpr atomic& operator=(const atomic&) = delete;
+		inline atomic_wait_slot atomic_wait_table[64] {};
 
-		void store(T desired, memory_order order) {
-			__atomic_store_n(&value, desired, static_cast<int>(order));
+		inline atomic_wait_slot& get_atomic_wait_slot(const void* addr) {
+			auto key = reinterpret_cast<uintptr_t>(addr);
+			return atomic_wait_table[((key >> 4) ^ (key >> 10)) % 64];
 		}
 
-		T load(memory_order order) const {
-			return __atomic_load_n(&value, static_cast<int>(order));
-		}
+#if defined(__x86_64__) || defined(__aarch64__)
+#define HZ_ATOMIC_HAS_CAS16 1
 
-		T exchange(T desired, memory_order order) {
-			return __atomic_exchange_n(&value, desired, static_cast<int>(order));
+		// 16-byte compare and swap, always a full barrier. On failure expected is set to the current value.
+		inline bool cas16(unsigned __int128* ptr, unsigned __int128& expected, unsigned __int128 desired) {
+			auto expected_lo = static_cast<uint64_t>(expected);
+			auto expected_hi = static_cast<uint64_t>(expected >> 64);
+			auto desired_lo = static_cast<uint64_t>(desired);
+			auto desired_hi = static_cast<uint64_t>(desired >> 64);
+#ifdef __x86_64__
+			bool success;
+			asm volatile(
+				"lock cmpxchg16b %[ptr]"
+				: "=@ccz"(success), [ptr] "+m"(*ptr), "+a"(expected_lo), "+d"(expected_hi)
+				: "b"(desired_lo), "c"(desired_hi)
+				: "memory");
+			expected = static_cast<unsigned __int128>(expected_hi) << 64 | expected_lo;
+			return success;
+#elif defined(__ARM_FEATURE_ATOMICS)
+			// casp needs consecutive even/odd register pairs
+			register uint64_t x0 asm("x0") = expected_lo;
+			register uint64_t x1 asm("x1") = expected_hi;
+			register uint64_t x2 asm("x2") = desired_lo;
+			register uint64_t x3 asm("x3") = desired_hi;
+			asm volatile(
+				"caspal %[lo], %[hi], %[dlo], %[dhi], %[ptr]"
+				: [lo] "+r"(x0), [hi] "+r"(x1), [ptr] "+Q"(*ptr)
+				: [dlo] "r"(x2), [dhi] "r"(x3)
+				: "memory");
+			bool success = x0 == expected_lo && x1 == expected_hi;
+			expected = static_cast<unsigned __int128>(x1) << 64 | x0;
+			return success;
+#else
+			uint64_t lo;
+			uint64_t hi;
+			uint32_t failed;
+			// on mismatch the loaded value is stored back so the read is atomic too
+			asm volatile(
+				"1: ldaxp %[lo], %[hi], %[ptr]\n"
+				"cmp %[lo], %[elo]\n"
+				"ccmp %[hi], %[ehi], #0, eq\n"
+				"b.ne 2f\n"
+				"stlxp %w[failed], %[dlo], %[dhi], %[ptr]\n"
+				"cbnz %w[failed], 1b\n"
+				"b 3f\n"
+				"2: stlxp %w[failed], %[lo], %[hi], %[ptr]\n"
+				"cbnz %w[failed], 1b\n"
+				"3:"
+				: [lo] "=&r"(lo), [hi] "=&r"(hi), [failed] "=&r"(failed), [ptr] "+Q"(*ptr)
+				: [elo] "r"(expected_lo), [ehi] "r"(expected_hi), [dlo] "r"(desired_lo), [dhi] "r"(desired_hi)
+				: "cc", "memory");
+			bool success = lo == expected_lo && hi == expected_hi;
+			expected = static_cast<unsigned __int128>(hi) << 64 | lo;
+			return success;
+#endif
 		}
+#endif
 
-		bool compare_exchange_weak(T& expected, T desired, memory_order success, memory_order failure) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, true, static_cast<int>(success), static_cast<int>(failure));
-		}
+		template<typename T>
+		inline constexpr bool use_cas16 =
+#ifdef HZ_ATOMIC_HAS_CAS16
+			sizeof(T) == 16;
+#else
+			false;
+#endif
 
-		bool compare_exchange_weak(T& expected, T desired, memory_order order) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, true, static_cast<int>(order), static_cast<int>(order));
-		}
+		// Operations shared by atomic and atomic_ref, Derived provides the address through get_address().
+		template<typename Derived, typename T>
+		class atomic_base {
+		public:
+			using value_type = T;
 
-		bool compare_exchange_strong(T& expected, T desired, memory_order success, memory_order failure) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, false, static_cast<int>(success), static_cast<int>(failure));
-		}
+			static constexpr bool is_always_lock_free = use_cas16<T> || __atomic_always_lock_free(sizeof(T), 0);
 
-		bool compare_exchange_strong(T&& expected, T desired, memory_order success, memory_order failure) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, false, static_cast<int>(success), static_cast<int>(failure));
-		}
+			// Power of two sized types are aligned to their size so the hardware can access them atomically.
+			static constexpr size_t required_alignment =
+				(sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) <= 16 && sizeof(T) > alignof(T) ? sizeof(T) : alignof(T);
 
-		bool compare_exchange_strong(T& expected, T desired, memory_order order) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, false, static_cast<int>(order), static_cast<int>(order));
-		}
+			void store(T desired, memory_order order) {
+				if constexpr (use_cas16<T>) {
+					auto* ptr = wide_address();
+					auto expected = static_cast<unsigned __int128>(0);
+					while (!cas16(ptr, expected, __builtin_bit_cast(unsigned __int128, desired)));
+				}
+				else {
+					__atomic_store(address(), &desired, static_cast<int>(order));
+				}
+			}
 
-		bool compare_exchange_strong(T&& expected, T desired, memory_order order) {
-			return __atomic_compare_exchange_n(&value, &expected, desired, false, static_cast<int>(order), static_cast<int>(order));
-		}
+			T load(memory_order order) const {
+				if constexpr (use_cas16<T>) {
+					// a compare and swap of zero with zero only writes if the value is zero
+					auto expected = static_cast<unsigned __int128>(0);
+					cas16(wide_address(), expected, 0);
+					return __builtin_bit_cast(T, expected);
+				}
+				else {
+					T result;
+					__atomic_load(address(), &result, static_cast<int>(order));
+					return result;
+				}
+			}
 
-		T fetch_add(T arg, memory_order order) requires(is_integral_v<T>) {
-			return __atomic_fetch_add(&value, arg, static_cast<int>(order));
-		}
-		T fetch_add(ptrdiff_t arg, memory_order order) requires(is_pointer_v<T>) {
-			return __atomic_fetch_add(&value, arg, static_cast<int>(order));
-		}
+			T exchange(T desired, memory_order order) {
+				if constexpr (use_cas16<T>) {
+					auto* ptr = wide_address();
+					auto expected = static_cast<unsigned __int128>(0);
+					while (!cas16(ptr, expected, __builtin_bit_cast(unsigned __int128, desired)));
+					return __builtin_bit_cast(T, expected);
+				}
+				else {
+					T result;
+					__atomic_exchange(address(), &desired, &result, static_cast<int>(order));
+					return result;
+				}
+			}
 
-		T fetch_sub(T arg, memory_order order) requires(is_integral_v<T>) {
-			return __atomic_fetch_sub(&value, arg, static_cast<int>(order));
-		}
-		T fetch_sub(ptrdiff_t arg, memory_order order) requires(is_pointer_v<T>) {
-			return __atomic_fetch_sub(&value, arg, static_cast<int>(order));
-		}
+			bool compare_exchange_weak(T& expected, T desired, memory_order success, memory_order failure) {
+				return compare_exchange(expected, desired, true, success, failure);
+			}
 
-		T fetch_and(T arg, memory_order order) requires(is_integral_v<T>) {
-			return __atomic_fetch_and(&value, arg, static_cast<int>(order));
-		}
-		T fetch_or(T arg, memory_order order) requires(is_integral_v<T>) {
-			return __atomic_fetch_or(&value, arg, static_cast<int>(order));
-		}
-		T fetch_xor(T arg, memory_order order) requires(is_integral_v<T>) {
-			return __atomic_fetch_xor(&value, arg, static_cast<int>(order));
-		}
+			bool compare_exchange_weak(T& expected, T desired, memory_order order) {
+				return compare_exchange(expected, desired, true, order, order);
+			}
+
+			bool compare_exchange_strong(T& expected, T desired, memory_order success, memory_order failure) {
+				return compare_exchange(expected, desired, false, success, failure);
+			}
+
+			bool compare_exchange_strong(T&& expected, T desired, memory_order success, memory_order failure) {
+				return compare_exchange(expected, desired, false, success, failure);
+			}
+
+			bool compare_exchange_strong(T& expected, T desired, memory_order order) {
+				return compare_exchange(expected, desired, false, order, order);
+			}
+
+			bool compare_exchange_strong(T&& expected, T desired, memory_order order) {
+				return compare_exchange(expected, desired, false, order, order);
+			}
+
+			T fetch_add(T arg, memory_order order) requires(is_integral_v<T>) {
+				return __atomic_fetch_add(address(), arg, static_cast<int>(order));
+			}
+			T fetch_add(ptrdiff_t arg, memory_order order) requires(is_pointer_v<T>) {
+				return __atomic_fetch_add(address(), arg, static_cast<int>(order));
+			}
+
+			T fetch_sub(T arg, memory_order order) requires(is_integral_v<T>) {
+				return __atomic_fetch_sub(address(), arg, static_cast<int>(order));
+			}
+			T fetch_sub(ptrdiff_t arg, memory_order order) requires(is_pointer_v<T>) {
+				return __atomic_fetch_sub(address(), arg, static_cast<int>(order));
+			}
+
+			T fetch_and(T arg, memory_order order) requires(is_integral_v<T>) {
+				return __atomic_fetch_and(address(), arg, static_cast<int>(order));
+			}
+			T fetch_or(T arg, memory_order order) requires(is_integral_v<T>) {
+				return __atomic_fetch_or(address(), arg, static_cast<int>(order));
+			}
+			T fetch_xor(T arg, memory_order order) requires(is_integral_v<T>) {
+				return __atomic_fetch_xor(address(), arg, static_cast<int>(order));
+			}
+
+			[[nodiscard]] bool is_lock_free() const {
+				return is_always_lock_free || __atomic_is_lock_free(sizeof(T), address());
+			}
+
+			// Blocks until the value is no longer equal to old, after spinning for a short while.
+			// 4-byte values are waited on directly, others through an epoch in a shared table.
+			template<futex_waiter Waiter = default_futex_waiter>
+			void wait(T old, memory_order order) const {
+				for (uint32_t i = 0; i < WAIT_SPINS; ++i) {
+					if (!equals(load(order), old)) {
+						return;
+					}
+					cpu_relax();
+				}
+
+				auto* addr = address();
+				auto& slot = get_atomic_wait_slot(addr);
+				__atomic_fetch_add(&slot.waiters, 1, __ATOMIC_SEQ_CST);
+				// pairs with the fence in notify so either the waiter sees the new value or the notifier the waiter
+				atomic_thread_fence(memory_order::seq_cst);
+				while (true) {
+					if constexpr (DIRECT_WAIT) {
+						if (!equals(load(order), old)) {
+							break;
+						}
+						Waiter::wait(reinterpret_cast<uint32_t*>(addr), __builtin_bit_cast(uint32_t, old));
+					}
+					else {
+						auto epoch = __atomic_load_n(&slot.epoch, __ATOMIC_ACQUIRE);
+						if (!equals(load(order), old)) {
+							break;
+						}
+						Waiter::wait(&slot.epoch, epoch);
+					}
+				}
+				__atomic_fetch_sub(&slot.waiters, 1, __ATOMIC_RELAXED);
+			}
+
+			// Wakes up a thread blocked in wait, the value has to be modified before.
+			template<futex_waiter Waiter = default_futex_waiter>
+			void notify_one() {
+				notify<Waiter>(false);
+			}
+
+			template<futex_waiter Waiter = default_futex_waiter>
+			void notify_all() {
+				notify<Waiter>(true);
+			}
+
+		private:
+			static constexpr uint32_t WAIT_SPINS = 64;
+			static constexpr bool DIRECT_WAIT = sizeof(T) == 4 && alignof(T) >= 4;
+
+			T* address() const {
+				return static_cast<const Derived*>(this)->get_address();
+			}
+
+			unsigned __int128* wide_address() const {
+				return reinterpret_cast<unsigned __int128*>(address());
+			}
+
+			static bool equals(const T& a, const T& b) {
+				return __builtin_memcmp(&a, &b, sizeof(T)) == 0;
+			}
+
+			bool compare_exchange(T& expected, T desired, bool weak, memory_order success, memory_order failure) {
+				if constexpr (use_cas16<T>) {
+					auto wide_expected = __builtin_bit_cast(unsigned __int128, expected);
+					bool result = cas16(wide_address(), wide_expected, __builtin_bit_cast(unsigned __int128, desired));
+					expected = __builtin_bit_cast(T, wide_expected);
+					return result;
+				}
+				else {
+					return __atomic_compare_exchange(
+						address(),
+						&expected,
+						&desired,
+						weak,
+						static_cast<int>(success),
+						static_cast<int>(failure));
+				}
+			}
+
+			template<futex_waiter Waiter>
+			void notify(bool all) {
+				auto* addr = address();
+				auto& slot = get_atomic_wait_slot(addr);
+				atomic_thread_fence(memory_order::seq_cst);
+				if (!__atomic_load_n(&slot.waiters, __ATOMIC_RELAXED)) {
+					return;
+				}
+
+				if constexpr (DIRECT_WAIT) {
+					if (all) {
+						Waiter::wake_all(reinterpret_cast<uint32_t*>(addr));
+					}
+					else {
+						Waiter::wake_one(reinterpret_cast<uint32_t*>(addr));
+					}
+				}
+				else {
+					// other addresses share the slot so everyone has to recheck
+					__atomic_fetch_add(&slot.epoch, 1, __ATOMIC_RELEASE);
+					Waiter::wake_all(&slot.epoch);
+				}
+			}
+		};
+	}
+
+	// 16-byte trivially copyable types use a double width compare and swap on x86-64 and aarch64,
+	// every operation on them is a full barrier.
+	template<typename T>
+	struct atomic : __detail::atomic_base<atomic<T>, T> {
+		constexpr atomic() = default;
+		constexpr atomic(T desired) : value {desired} {} // NOLINT(*-explicit-constructor)
+		constexpr atomic(const atomic&) = delete;
+
+		constexpr atomic& operator=(const atomic&) = delete;
 
 		constexpr T* data() {
 			return &value;
@@ -91,6 +328,32 @@ namespace hz {
 		}
 
 	private:
-		T value;
+		friend __detail::atomic_base<atomic<T>, T>;
+
+		T* get_address() const {
+			return const_cast<T*>(&value);
+		}
+
+		alignas(__detail::atomic_base<atomic<T>, T>::required_alignment) T value;
+	};
+
+	// Atomic access to an object that isn't an hz::atomic, e.g. a field of an existing struct.
+	// The object must be aligned to required_alignment and only accessed atomically while referenced.
+	template<typename T>
+	class atomic_ref : public __detail::atomic_base<atomic_ref<T>, T> {
+	public:
+		constexpr explicit atomic_ref(T& object) : ptr {&object} {}
+		constexpr atomic_ref(const atomic_ref&) = default;
+
+		atomic_ref& operator=(const atomic_ref&) = delete;
+
+	private:
+		friend __detail::atomic_base<atomic_ref<T>, T>;
+
+		T* get_address() const {
+			return ptr;
+		}
+
+		T* ptr;
 	};
 }
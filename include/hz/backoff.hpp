@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#if __STDC_HOSTED__ == 1
+#include <sched.h>
+#endif
+
+namespace hz {
+	// Called by spinning locks on every failed iteration, a fresh object is used for every acquisition.
+	template<typename T>
+	concept backoff_policy = requires(T backoff) {
+		T {};
+		backoff.wait();
+	};
+
+	// A single pause per iteration, on aarch64 the waiter sleeps until the owner signals an event.
+	// Only valid for locks whose unlock executes sev.
+	struct pause_backoff {
+		void wait() {
+#ifdef __x86_64__
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			asm volatile("wfe");
+#endif
+		}
+	};
+
+	struct no_yield {
+		static void yield() {}
+	};
+
+#if __STDC_HOSTED__ == 1
+	struct thread_yield {
+		static void yield() {
+			sched_yield();
+		}
+	};
+#endif
+
+	// Doubles the number of pauses per iteration up to MaxSpins,
+	// after that Yield is called on every iteration to give up the cpu.
+	template<uint32_t MinSpins = 1, uint32_t MaxSpins = 1024, typename Yield = no_yield>
+	struct exponential_backoff {
+		static_assert(MinSpins > 0 && MinSpins <= MaxSpins);
+
+		void wait() {
+			for (uint32_t i = 0; i < spins; ++i) {
+				cpu_relax();
+			}
+
+			if (spins < MaxSpins) {
+				spins = spins * 2 > MaxSpins ? MaxSpins : spins * 2;
+			}
+			else {
+				Yield::yield();
+			}
+		}
+
+		uint32_t spins = MinSpins;
+	};
+}
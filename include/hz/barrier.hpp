@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#include "futex.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	struct no_barrier_completion {
+		void operator()() {}
+	};
+
+	// Reusable barrier for a fixed group of threads. Every phase ends when all of them arrived,
+	// the last one runs Completion before the others are released into the next phase.
+	// Instead of a sense flag the barrier keeps a phase counter, threads wait for it to move past
+	// the phase they arrived in, so a fast thread can't be confused by the next phase.
+	// Waiters spin briefly and then sleep through Waiter, spin_waiter makes them spin only.
+	template<typename Completion = no_barrier_completion, futex_waiter Waiter = default_futex_waiter>
+	class barrier {
+	public:
+		using arrival_token = uint32_t;
+
+		constexpr explicit barrier(uint32_t count, Completion completion = {})
+			: completion {std::move(completion)}, expected {count}, remaining {count} {}
+
+		barrier(const barrier&) = delete;
+		barrier& operator=(const barrier&) = delete;
+
+		// Arrives without waiting, the token can be passed to wait.
+		[[nodiscard]] arrival_token arrive() {
+			auto current = phase.load(memory_order::relaxed);
+			if (remaining.fetch_sub(1, memory_order::acq_rel) == 1) {
+				completion();
+				remaining.store(expected.load(memory_order::relaxed), memory_order::relaxed);
+				phase.store(current + 1, memory_order::release);
+				phase.template notify_all<Waiter>();
+			}
+			return current;
+		}
+
+		// Waits until the phase the token was obtained in completed.
+		void wait(arrival_token token) const {
+			while (phase.load(memory_order::acquire) == token) {
+				phase.template wait<Waiter>(token, memory_order::acquire);
+			}
+		}
+
+		void arrive_and_wait() {
+			wait(arrive());
+		}
+
+		// Arrives and removes the calling thread from all following phases.
+		void arrive_and_drop() {
+			expected.fetch_sub(1, memory_order::relaxed);
+			static_cast<void>(arrive());
+		}
+
+	private:
+		[[no_unique_address]] Completion completion;
+		atomic<uint32_t> expected;
+		atomic<uint32_t> remaining;
+		atomic<uint32_t> phase {};
+	};
+}
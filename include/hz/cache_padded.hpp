@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Minimum distance between two objects written by different threads to avoid false sharing.
+	// Apple and other aarch64 cores use 128 byte lines and x86 prefetches pairs of 64 byte lines,
+	// but 64 bytes is what the x86 coherence protocol works with.
+#if defined(__aarch64__) || defined(__powerpc64__)
+	inline constexpr size_t hardware_destructive_interference_size = 128;
+#else
+	inline constexpr size_t hardware_destructive_interference_size = 64;
+#endif
+
+	// Maximum size of data that is guaranteed to share a cache line.
+	inline constexpr size_t hardware_constructive_interference_size = 64;
+
+	// Wraps T so that it occupies its own cache line(s), e.g. for arrays of locks or per-thread counters.
+	template<typename T>
+	class alignas(hardware_destructive_interference_size) cache_padded {
+	public:
+		constexpr cache_padded() = default;
+
+		template<typename... Args>
+		constexpr explicit cache_padded(Args&&... args) : value {std::forward<Args>(args)...} {}
+
+		constexpr T& operator*() {
+			return value;
+		}
+
+		constexpr const T& operator*() const {
+			return value;
+		}
+
+		constexpr T* operator->() {
+			return &value;
+		}
+
+		constexpr const T* operator->() const {
+			return &value;
+		}
+
+	private:
+		T value {};
+	};
+}
@@ -0,0 +1,331 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.hpp"
+#include "atomic.hpp"
+#include "bit.hpp"
+#include "epoch.hpp"
+#include "optional.hpp"
+#if __STDC_HOSTED__ == 1
+#include <new>
+#include <utility>
+#else
+#include "new.hpp"
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Lock-free ordered map (Fraser/Herlihy-Shavit skip list). The lowest level defines the contents,
+	// upper levels are shortcuts. Removal first marks the next pointers of a node, which makes it
+	// logically deleted, and then unlinks it at every level, traversals help unlinking marked nodes.
+	// A node counts the levels it is linked at and is retired through an epoch_domain once the last
+	// one was unlinked, so readers can traverse without writing shared memory.
+	// Keys are compared with operator<, values are copied out while the reader is pinned.
+	template<typename K, typename V, Allocator Allocator, size_t MaxLevel = 20>
+	class concurrent_skip_list {
+	public:
+		static_assert(MaxLevel > 0 && MaxLevel <= 32);
+
+		explicit concurrent_skip_list(Allocator alloc) : alloc {std::move(alloc)}, domain {this} {}
+
+		concurrent_skip_list(const concurrent_skip_list&) = delete;
+		concurrent_skip_list& operator=(const concurrent_skip_list&) = delete;
+
+		// All thread records must have been destroyed before.
+		~concurrent_skip_list() {
+			// nodes still linked at some level, they are freed once they were seen at all of them
+			for (size_t level = MaxLevel; level-- > 0;) {
+				auto* node = to_node(head[level].load(memory_order::relaxed));
+				while (node) {
+					auto* next = to_node(node->next(level).load(memory_order::relaxed));
+					if (node->links.fetch_sub(1, memory_order::relaxed) == 1) {
+						free_node(node);
+					}
+					node = next;
+				}
+			}
+		}
+
+		// Registers a thread with the map, in hosted environments usually a thread_local.
+		class thread_record {
+		public:
+			explicit thread_record(concurrent_skip_list& owner)
+				: record {owner.domain}, seed {reinterpret_cast<uintptr_t>(this) | 1} {}
+
+		private:
+			friend concurrent_skip_list;
+
+			// Returns a height in [1, MaxLevel], every level is half as likely as the one below.
+			size_t random_height() {
+				seed ^= seed << 13;
+				seed ^= seed >> 7;
+				seed ^= seed << 17;
+				return 1 + countr_zero(static_cast<uint32_t>(seed) | uint32_t {1} << (MaxLevel - 1));
+			}
+
+			epoch_domain::thread_record record;
+			uint64_t seed;
+		};
+
+		// Returns false if the key already exists or the node can't be allocated.
+		bool insert(thread_record& record, const K& key, V value) {
+			auto pin = record.record.pin();
+			atomic<uintptr_t>* preds[MaxLevel];
+			Node* succs[MaxLevel];
+			Node* node = nullptr;
+			while (true) {
+				if (search(record, key, preds, succs)) {
+					if (node) {
+						free_node(node);
+					}
+					return false;
+				}
+
+				if (!node) {
+					node = create_node(key, std::move(value), record.random_height());
+					if (!node) {
+						return false;
+					}
+				}
+
+				auto expected = to_raw(succs[0]);
+				node->next(0).store(expected, memory_order::relaxed);
+				if (preds[0]->compare_exchange_strong(expected, to_raw(node), memory_order::release, memory_order::relaxed)) {
+					break;
+				}
+			}
+
+			link_upper_levels(record, node, preds, succs);
+			return true;
+		}
+
+		// Returns false if the key doesn't exist or another thread removed it first.
+		bool remove(thread_record& record, const K& key) {
+			auto pin = record.record.pin();
+			atomic<uintptr_t>* preds[MaxLevel];
+			Node* succs[MaxLevel];
+			if (!search(record, key, preds, succs)) {
+				return false;
+			}
+
+			auto* node = succs[0];
+			for (size_t level = node->height; level-- > 1;) {
+				auto next = node->next(level).load(memory_order::relaxed);
+				while (!is_marked(next)) {
+					node->next(level).compare_exchange_weak(next, next | MARK, memory_order::relaxed, memory_order::relaxed);
+				}
+			}
+
+			// whoever marks the lowest level removed the key
+			auto next = node->next(0).load(memory_order::relaxed);
+			while (true) {
+				if (is_marked(next)) {
+					return false;
+				}
+				if (node->next(0).compare_exchange_weak(next, next | MARK, memory_order::release, memory_order::relaxed)) {
+					break;
+				}
+			}
+
+			// unlinks the node at all levels
+			search(record, key, preds, succs);
+			return true;
+		}
+
+		optional<V> find(thread_record& record, const K& key) {
+			auto pin = record.record.pin();
+			auto* node = lower_bound(key);
+			if (!node || key < node->key) {
+				return nullopt;
+			}
+			return node->value;
+		}
+
+		bool contains(thread_record& record, const K& key) {
+			auto pin = record.record.pin();
+			auto* node = lower_bound(key);
+			return node && !(key < node->key);
+		}
+
+		// Calls fn(key, value) in order for every key in [from, to). Keys inserted or removed
+		// concurrently may or may not be visited.
+		template<typename F>
+		void scan(thread_record& record, const K& from, const K& to, F fn) {
+			auto pin = record.record.pin();
+			for (auto* node = lower_bound(from); node && node->key < to;) {
+				auto next = node->next(0).load(memory_order::acquire);
+				if (!is_marked(next)) {
+					fn(static_cast<const K&>(node->key), static_cast<const V&>(node->value));
+				}
+				node = to_node(next);
+			}
+		}
+
+	private:
+		static constexpr uintptr_t MARK = 1;
+
+		struct Node : epoch_hook {
+			atomic<uintptr_t>& next(size_t level) {
+				return reinterpret_cast<atomic<uintptr_t>*>(reinterpret_cast<char*>(this) + NEXT_OFFSET)[level];
+			}
+
+			K key;
+			V value;
+			// levels the node is linked at, plus one while the inserter is still linking
+			atomic<uint32_t> links;
+			uint32_t height;
+		};
+
+		static constexpr size_t NEXT_OFFSET =
+			(sizeof(Node) + alignof(atomic<uintptr_t>) - 1) & ~(alignof(atomic<uintptr_t>) - 1);
+
+		static constexpr size_t node_size(size_t height) {
+			return NEXT_OFFSET + height * sizeof(atomic<uintptr_t>);
+		}
+
+		static bool is_marked(uintptr_t value) {
+			return value & MARK;
+		}
+
+		static Node* to_node(uintptr_t value) {
+			return reinterpret_cast<Node*>(value & ~MARK);
+		}
+
+		static uintptr_t to_raw(Node* node) {
+			return reinterpret_cast<uintptr_t>(node);
+		}
+
+		Node* create_node(const K& key, V&& value, size_t height) {
+			auto* ptr = alloc.allocate(node_size(height));
+			if (!ptr) {
+				return nullptr;
+			}
+
+			auto* node = new (ptr) Node {{}, key, std::move(value), {}, static_cast<uint32_t>(height)};
+			for (size_t level = 0; level < height; ++level) {
+				new (&node->next(level)) atomic<uintptr_t> {};
+			}
+			// the lowest level and the inserter
+			node->links.store(2, memory_order::relaxed);
+			return node;
+		}
+
+		void free_node(Node* node) {
+			auto height = node->height;
+			node->~Node();
+			if constexpr (SizedAllocator<Allocator>) {
+				alloc.deallocate(node, node_size(height));
+			}
+			else {
+				alloc.deallocate(node);
+			}
+		}
+
+		static void reclaim(epoch_hook* hook, void* context) {
+			static_cast<concurrent_skip_list*>(context)->free_node(static_cast<Node*>(hook));
+		}
+
+		// Called after the node was unlinked at one level or the inserter finished.
+		void release_link(thread_record& record, Node* node) {
+			if (node->links.fetch_sub(1, memory_order::acq_rel) == 1) {
+				record.record.retire(node, reclaim);
+			}
+		}
+
+		// Links the levels above the lowest one. Stops early if the node is removed meanwhile,
+		// levels linked after the remover unlinked the node are cleaned up by another search.
+		void link_upper_levels(thread_record& record, Node* node, atomic<uintptr_t>** preds, Node** succs) {
+			for (size_t level = 1; level < node->height; ++level) {
+				while (true) {
+					auto next = node->next(level).load(memory_order::relaxed);
+					if (is_marked(next) ||
+						!node->next(level).compare_exchange_strong(next, to_raw(succs[level]), memory_order::relaxed, memory_order::relaxed)) {
+						level = node->height;
+						break;
+					}
+
+					node->links.fetch_add(1, memory_order::relaxed);
+					auto expected = to_raw(succs[level]);
+					if (preds[level]->compare_exchange_strong(expected, to_raw(node), memory_order::release, memory_order::relaxed)) {
+						break;
+					}
+					node->links.fetch_sub(1, memory_order::relaxed);
+
+					search(record, node->key, preds, succs);
+					if (succs[0] != node) {
+						level = node->height;
+						break;
+					}
+				}
+			}
+
+			if (is_marked(node->next(0).load(memory_order::acquire))) {
+				search(record, node->key, preds, succs);
+			}
+			release_link(record, node);
+		}
+
+		// Fills the link to update and the following node at every level for key,
+		// unlinking marked nodes on the way. Returns true if the lowest level contains key.
+		bool search(thread_record& record, const K& key, atomic<uintptr_t>** preds, Node** succs) {
+			while (!try_search(record, key, preds, succs));
+			return succs[0] && !(key < succs[0]->key);
+		}
+
+		// Fails if a link changed while unlinking a marked node.
+		bool try_search(thread_record& record, const K& key, atomic<uintptr_t>** preds, Node** succs) {
+			Node* pred = nullptr;
+			for (size_t level = MaxLevel; level-- > 0;) {
+				auto* link = pred ? &pred->next(level) : &head[level];
+				auto* curr = to_node(link->load(memory_order::acquire));
+				while (curr) {
+					auto next = curr->next(level).load(memory_order::acquire);
+					if (is_marked(next)) {
+						auto expected = to_raw(curr);
+						if (!link->compare_exchange_strong(expected, next & ~MARK, memory_order::acq_rel, memory_order::relaxed)) {
+							return false;
+						}
+						release_link(record, curr);
+						curr = to_node(next);
+						continue;
+					}
+					if (!(curr->key < key)) {
+						break;
+					}
+					pred = curr;
+					link = &curr->next(level);
+					curr = to_node(next);
+				}
+				preds[level] = link;
+				succs[level] = curr;
+			}
+			return true;
+		}
+
+		// First node on the lowest level that isn't marked and not smaller than key, doesn't write.
+		Node* lower_bound(const K& key) {
+			Node* pred = nullptr;
+			Node* curr = nullptr;
+			for (size_t level = MaxLevel; level-- > 0;) {
+				curr = to_node((pred ? pred->next(level) : head[level]).load(memory_order::acquire));
+				while (curr && curr->key < key) {
+					pred = curr;
+					curr = to_node(curr->next(level).load(memory_order::acquire));
+				}
+			}
+
+			while (curr) {
+				auto next = curr->next(0).load(memory_order::acquire);
+				if (!is_marked(next)) {
+					break;
+				}
+				curr = to_node(next);
+			}
+			return curr;
+		}
+
+		atomic<uintptr_t> head[MaxLevel] {};
+		Allocator alloc;
+		epoch_domain domain;
+	};
+}
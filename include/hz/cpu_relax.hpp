@@ -0,0 +1,12 @@
+#pragma once
+
+namespace hz {
+	// Hint to the cpu that the caller is busy waiting.
+	inline void cpu_relax() {
+#ifdef __x86_64__
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+}
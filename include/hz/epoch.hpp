@@ -0,0 +1,204 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "double_list.hpp"
+#include "spinlock.hpp"
+
+namespace hz {
+	class epoch_domain;
+
+	// Embedded into objects that are retired through an epoch_domain.
+	struct epoch_hook {
+		epoch_hook* next {};
+		uint64_t epoch {};
+		void (*reclaim)(epoch_hook* hook, void* context) {};
+	};
+
+	// Epoch based reclamation. Readers pin their thread record while they access shared objects,
+	// writers unlink objects and retire them, and retired objects are reclaimed in batches once
+	// the global epoch advanced twice, at which point no pinned reader can still see them.
+	// The epoch advances when every pinned thread has observed the current one.
+	class epoch_domain {
+	public:
+		// Called with the hook of a retired object and the context pointer of the domain.
+		using reclaim_fn = void (*)(epoch_hook* hook, void* context);
+
+		constexpr explicit epoch_domain(void* context = nullptr, size_t batch_size = 64)
+			: context {context}, batch_size {batch_size} {}
+
+		epoch_domain(const epoch_domain&) = delete;
+		epoch_domain& operator=(const epoch_domain&) = delete;
+
+		// All thread records must have been destroyed before.
+		~epoch_domain() {
+			auto orphans_guard = orphans.lock();
+			reclaim_until(orphans_guard->head, orphans_guard->tail, UINT64_MAX);
+		}
+
+		// Registers a thread with the domain, in hosted environments usually a thread_local.
+		// Freestanding users keep it in their thread structure and destroy it on thread exit,
+		// objects the thread retired but didn't reclaim yet are handed to the domain.
+		class alignas(hardware_destructive_interference_size) thread_record {
+		public:
+			explicit thread_record(epoch_domain& domain) : domain {&domain} {
+				domain.records->lock()->push(this);
+			}
+
+			thread_record(const thread_record&) = delete;
+			thread_record& operator=(const thread_record&) = delete;
+
+			~thread_record() {
+				domain->records->lock()->remove(this);
+				if (retired_head) {
+					auto guard = domain->orphans.lock();
+					if (guard->tail) {
+						guard->tail->next = retired_head;
+					}
+					else {
+						guard->head = retired_head;
+					}
+					guard->tail = retired_tail;
+				}
+			}
+
+			struct guard {
+				constexpr guard(const guard&) = delete;
+				constexpr guard& operator=(const guard&) = delete;
+
+				inline ~guard() {
+					owner->exit();
+				}
+
+			private:
+				friend thread_record;
+
+				constexpr explicit guard(thread_record* owner) : owner {owner} {}
+
+				thread_record* owner;
+			};
+
+			// Marks the thread as reading until the guard is destroyed, pins can be nested.
+			[[nodiscard]] guard pin() {
+				enter();
+				return guard {this};
+			}
+
+			void enter() {
+				if (nesting++) {
+					return;
+				}
+				auto epoch = domain->global_epoch->load(memory_order::relaxed);
+				state.store(epoch << 1 | 1, memory_order::relaxed);
+				// orders the state store before any load of shared objects, pairs with the fence in try_advance
+				atomic_thread_fence(memory_order::seq_cst);
+			}
+
+			void exit() {
+				if (--nesting) {
+					return;
+				}
+				state.store(0, memory_order::release);
+			}
+
+			// Schedules hook for reclamation, the object must already be unreachable for new readers.
+			void retire(epoch_hook* hook, reclaim_fn reclaim) {
+				hook->next = nullptr;
+				hook->reclaim = reclaim;
+				hook->epoch = domain->global_epoch->load(memory_order::seq_cst);
+				if (retired_tail) {
+					retired_tail->next = hook;
+				}
+				else {
+					retired_head = hook;
+				}
+				retired_tail = hook;
+
+				if (++retired_count >= domain->batch_size) {
+					collect();
+				}
+			}
+
+			// Tries to advance the epoch and reclaims the objects of this thread that became safe.
+			size_t collect() {
+				auto epoch = domain->try_advance();
+				auto reclaimed = domain->reclaim_until(retired_head, retired_tail, epoch);
+				retired_count -= reclaimed;
+				return reclaimed;
+			}
+
+		private:
+			friend epoch_domain;
+
+			epoch_domain* domain;
+			list_hook hook {};
+			// epoch << 1 | 1 while pinned, 0 otherwise
+			atomic<uint64_t> state {};
+			uint32_t nesting {};
+			epoch_hook* retired_head {};
+			epoch_hook* retired_tail {};
+			size_t retired_count {};
+		};
+
+		// Tries to advance the epoch and reclaims objects left behind by exited threads.
+		size_t drain() {
+			try_advance();
+			auto epoch = try_advance();
+			auto guard = orphans.lock();
+			return reclaim_until(guard->head, guard->tail, epoch);
+		}
+
+		[[nodiscard]] uint64_t get_epoch() const {
+			return global_epoch->load(memory_order::relaxed);
+		}
+
+	private:
+		// Returns the global epoch after the attempt.
+		uint64_t try_advance() {
+			auto epoch = global_epoch->load(memory_order::relaxed);
+			atomic_thread_fence(memory_order::seq_cst);
+			{
+				auto guard = records->lock();
+				for (auto& record : *guard) {
+					auto state = record.state.load(memory_order::relaxed);
+					if ((state & 1) && state >> 1 != epoch) {
+						return epoch;
+					}
+				}
+			}
+
+			if (global_epoch->compare_exchange_strong(epoch, epoch + 1, memory_order::acq_rel, memory_order::relaxed)) {
+				return epoch + 1;
+			}
+			return epoch;
+		}
+
+		// Reclaims retired objects from the front of the list that were retired at least two epochs before epoch.
+		size_t reclaim_until(epoch_hook*& head, epoch_hook*& tail, uint64_t epoch) {
+			atomic_thread_fence(memory_order::acquire);
+			size_t count = 0;
+			while (head && (epoch == UINT64_MAX || head->epoch + 2 <= epoch)) {
+				auto* hook = head;
+				head = hook->next;
+				hook->reclaim(hook, context);
+				++count;
+			}
+			if (!head) {
+				tail = nullptr;
+			}
+			return count;
+		}
+
+		struct Orphans {
+			epoch_hook* head;
+			epoch_hook* tail;
+		};
+
+		cache_padded<atomic<uint64_t>> global_epoch {};
+		cache_padded<spinlock<list<thread_record, &thread_record::hook>>> records {};
+		spinlock<Orphans> orphans {};
+		void* context;
+		size_t batch_size;
+	};
+}
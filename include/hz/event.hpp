@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#include "futex.hpp"
+
+namespace hz {
+	// One shot event, once set every current and future wait returns immediately.
+	// Waiters spin briefly and then sleep through Waiter, spin_waiter makes them spin only.
+	template<futex_waiter Waiter = default_futex_waiter>
+	class event {
+	public:
+		constexpr event() = default;
+
+		event(const event&) = delete;
+		event& operator=(const event&) = delete;
+
+		// Everything done before set is visible to threads returning from wait.
+		void set() {
+			if (!state.exchange(1, memory_order::release)) {
+				state.template notify_all<Waiter>();
+			}
+		}
+
+		[[nodiscard]] bool is_set() const {
+			return state.load(memory_order::acquire);
+		}
+
+		void wait() const {
+			while (!state.load(memory_order::acquire)) {
+				state.template wait<Waiter>(0, memory_order::acquire);
+			}
+		}
+
+	private:
+		atomic<uint32_t> state {};
+	};
+}
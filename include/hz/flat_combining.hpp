@@ -0,0 +1,155 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "cpu_relax.hpp"
+#include "double_list.hpp"
+#include "manually_init.hpp"
+#include "spinlock.hpp"
+#include "type_traits.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Flat combining wrapper for data structures that are hard to make concurrent.
+	// Threads publish their operation in their own thread record, whichever thread gets the lock
+	// becomes the combiner and executes all pending operations in one pass while the structure
+	// stays hot in its cache. The others spin on their own record until their operation is done.
+	template<typename T>
+	class flat_combining {
+	public:
+		constexpr flat_combining() = default;
+
+		constexpr flat_combining(T&& data) : data {std::move(data)} {} // NOLINT(*-explicit-constructor)
+		constexpr flat_combining(const T& data) : data {data} {} // NOLINT(*-explicit-constructor)
+
+		flat_combining(const flat_combining&) = delete;
+		flat_combining& operator=(const flat_combining&) = delete;
+
+		// Registers a thread with the wrapper, in hosted environments usually a thread_local.
+		// Freestanding users keep it in their thread structure and destroy it on thread exit.
+		class alignas(hardware_destructive_interference_size) thread_record {
+		public:
+			explicit thread_record(flat_combining& owner) : owner {&owner} {
+				owner.records->lock()->push(this);
+			}
+
+			thread_record(const thread_record&) = delete;
+			thread_record& operator=(const thread_record&) = delete;
+
+			~thread_record() {
+				owner->records->lock()->remove(this);
+			}
+
+			// Executes fn(T&) with exclusive access to the data, possibly on another thread,
+			// and returns its result. fn must not depend on the calling thread or use this wrapper.
+			template<typename F>
+			auto apply(F fn) -> decltype(fn(*static_cast<T*>(nullptr))) {
+				using R = decltype(fn(*static_cast<T*>(nullptr)));
+
+				if constexpr (is_same_v<R, void>) {
+					publish(&fn, [](void* op, T& data) {
+						(*static_cast<F*>(op))(data);
+					});
+					wait();
+				}
+				else {
+					struct Op {
+						F* fn;
+						manually_init<R> result;
+					};
+					Op op {.fn = &fn, .result {}};
+					publish(&op, [](void* ptr, T& data) {
+						auto* op = static_cast<Op*>(ptr);
+						op->result.initialize((*op->fn)(data));
+					});
+					wait();
+					R result {std::move(*op.result)};
+					op.result.destroy();
+					return result;
+				}
+			}
+
+		private:
+			friend flat_combining;
+
+			static constexpr uint32_t IDLE = 0;
+			static constexpr uint32_t PENDING = 1;
+			static constexpr uint32_t DONE = 2;
+			static constexpr uint32_t SPINS = 64;
+
+			void publish(void* new_op, void (*new_invoke)(void* op, T& data)) {
+				op = new_op;
+				invoke = new_invoke;
+				state.store(PENDING, memory_order::release);
+			}
+
+			void wait() {
+				while (true) {
+					if (state.load(memory_order::acquire) == DONE) {
+						break;
+					}
+					if (auto guard = owner->data.try_lock()) {
+						owner->combine(*guard);
+						continue;
+					}
+					for (uint32_t i = 0; i < SPINS && state.load(memory_order::relaxed) != DONE; ++i) {
+						cpu_relax();
+					}
+				}
+				state.store(IDLE, memory_order::relaxed);
+			}
+
+			flat_combining* owner;
+			list_hook hook {};
+			atomic<uint32_t> state {};
+			void* op {};
+			void (*invoke)(void* op, T& data) {};
+			// links the records collected by the combiner, only used with the data lock held
+			thread_record* next_pending {};
+		};
+
+		// Direct exclusive access, pending operations are combined by the next thread applying one.
+		[[nodiscard]] auto lock() {
+			return data.lock();
+		}
+
+		T& get_unsafe() {
+			return data.get_unsafe();
+		}
+
+	private:
+		static constexpr size_t COMBINE_PASSES = 2;
+
+		// Called with the data lock held. A second pass picks up operations published meanwhile.
+		// The pending records are only collected under the records lock so registering threads don't
+		// wait for the operations, their owners keep them alive until they are marked as done.
+		void combine(T& value) {
+			for (size_t pass = 0; pass < COMBINE_PASSES; ++pass) {
+				thread_record* pending = nullptr;
+				{
+					auto guard = records->lock();
+					for (auto& record : *guard) {
+						if (record.state.load(memory_order::acquire) == thread_record::PENDING) {
+							record.next_pending = pending;
+							pending = &record;
+						}
+					}
+				}
+
+				while (auto* record = pending) {
+					pending = record->next_pending;
+					record->invoke(record->op, value);
+					record->state.store(thread_record::DONE, memory_order::release);
+				}
+			}
+		}
+
+		spinlock<T> data {};
+		cache_padded<spinlock<list<thread_record, &thread_record::hook>>> records {};
+	};
+}
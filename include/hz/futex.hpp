@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include "cpu_relax.hpp"
+#if __STDC_HOSTED__ == 1 && defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hz {
+	// Lets a thread sleep on a 32-bit word until another thread changes it and wakes it up.
+	// wait returns immediately if *addr != expected and may return spuriously,
+	// freestanding users can wire this up to their own scheduler.
+	template<typename T>
+	concept futex_waiter = requires(uint32_t* addr, uint32_t expected) {
+		T::wait(addr, expected);
+		T::wake_one(addr);
+		T::wake_all(addr);
+	};
+
+	// Busy waits, for environments without a way to sleep.
+	struct spin_waiter {
+		static void wait(uint32_t* addr, uint32_t expected) {
+			while (__atomic_load_n(addr, __ATOMIC_RELAXED) == expected) {
+				cpu_relax();
+			}
+		}
+
+		static void wake_one(uint32_t*) {}
+
+		static void wake_all(uint32_t*) {}
+	};
+
+#if __STDC_HOSTED__ == 1 && defined(__linux__)
+	struct linux_futex_waiter {
+		static void wait(uint32_t* addr, uint32_t expected) {
+			syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+		}
+
+		static void wake_one(uint32_t* addr) {
+			syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+		}
+
+		static void wake_all(uint32_t* addr) {
+			syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+		}
+	};
+
+	using default_futex_waiter = linux_futex_waiter;
+#else
+	using default_futex_waiter = spin_waiter;
+#endif
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "double_list.hpp"
+#include "spinlock.hpp"
+
+namespace hz {
+	// Embedded into objects that are retired through a hazard_domain.
+	struct hazard_hook {
+		hazard_hook* next {};
+		void (*reclaim)(hazard_hook* hook, void* context) {};
+	};
+
+	// Hazard pointer reclamation. Readers publish the pointers they are about to dereference
+	// in one of Slots per-thread slots, and retired objects are only reclaimed once no slot holds them.
+	// Unlike epochs a stalled reader only keeps the objects it protects alive, every thread has
+	// at most scan_threshold + Slots * thread count objects waiting for reclamation.
+	template<size_t Slots = 2>
+	class hazard_domain {
+	public:
+		// Called with the hook of a retired object and the context pointer of the domain,
+		// without any lock held so callbacks of different threads may run concurrently.
+		using reclaim_fn = void (*)(hazard_hook* hook, void* context);
+
+		constexpr explicit hazard_domain(void* context = nullptr, size_t scan_threshold = 64)
+			: context {context}, scan_threshold {scan_threshold} {}
+
+		hazard_domain(const hazard_domain&) = delete;
+		hazard_domain& operator=(const hazard_domain&) = delete;
+
+		// All thread records must have been destroyed before.
+		~hazard_domain() {
+			auto guard = orphans.lock();
+			while (auto* hook = guard->head) {
+				guard->head = hook->next;
+				hook->reclaim(hook, context);
+			}
+		}
+
+		// Registers a thread with the domain, in hosted environments usually a thread_local.
+		// Freestanding users keep it in their thread structure and destroy it on thread exit,
+		// objects that are still protected by other threads at that point are handed to the domain.
+		class alignas(hardware_destructive_interference_size) thread_record {
+		public:
+			explicit thread_record(hazard_domain& domain) : domain {&domain} {
+				domain.records->lock()->push(this);
+			}
+
+			thread_record(const thread_record&) = delete;
+			thread_record& operator=(const thread_record&) = delete;
+
+			~thread_record() {
+				for (auto& slot : slots) {
+					slot.store(nullptr, memory_order::release);
+				}
+				scan();
+				domain->records->lock()->remove(this);
+
+				if (retired) {
+					auto guard = domain->orphans.lock();
+					auto* tail = retired;
+					while (tail->next) {
+						tail = tail->next;
+					}
+					tail->next = guard->head;
+					guard->head = retired;
+				}
+			}
+
+			// Publishes the pointer currently stored in src in the given slot and returns it,
+			// it stays valid until the slot is reset or reused even if it is retired meanwhile.
+			// T must derive from hazard_hook.
+			template<typename T>
+			T* protect(size_t slot, const atomic<T*>& src) {
+				auto* ptr = src.load(memory_order::relaxed);
+				while (true) {
+					slots[slot].store(static_cast<hazard_hook*>(ptr), memory_order::relaxed);
+					// orders the slot store before the validating load, pairs with the fence in scan
+					atomic_thread_fence(memory_order::seq_cst);
+					auto* current = src.load(memory_order::acquire);
+					if (current == ptr) {
+						return ptr;
+					}
+					ptr = current;
+				}
+			}
+
+			void reset(size_t slot) {
+				slots[slot].store(nullptr, memory_order::release);
+			}
+
+			// Schedules hook for reclamation, the object must already be unreachable for new readers.
+			void retire(hazard_hook* hook, reclaim_fn reclaim) {
+				hook->reclaim = reclaim;
+				hook->next = retired;
+				retired = hook;
+				domain->unreclaimed->fetch_add(1, memory_order::relaxed);
+				if (++retired_count >= domain->scan_threshold) {
+					scan();
+				}
+			}
+
+			// Reclaims every retired object of this thread that isn't protected by any slot.
+			size_t scan() {
+				atomic_thread_fence(memory_order::seq_cst);
+
+				hazard_hook* keep = nullptr;
+				hazard_hook* unprotected = nullptr;
+				size_t count = 0;
+				{
+					auto guard = domain->records->lock();
+					while (auto* hook = retired) {
+						retired = hook->next;
+						if (domain->is_protected(*guard, hook)) {
+							hook->next = keep;
+							keep = hook;
+						}
+						else {
+							hook->next = unprotected;
+							unprotected = hook;
+							++count;
+						}
+					}
+				}
+
+				// the record is consistent before any callback runs as they may retire again
+				retired = keep;
+				retired_count -= count;
+				domain->reclaim_all(unprotected);
+				return count;
+			}
+
+		private:
+			friend hazard_domain;
+
+			hazard_domain* domain;
+			list_hook hook {};
+			atomic<hazard_hook*> slots[Slots] {};
+			hazard_hook* retired {};
+			size_t retired_count {};
+		};
+
+		// Reclaims objects left behind by exited threads that aren't protected anymore.
+		size_t drain() {
+			atomic_thread_fence(memory_order::seq_cst);
+
+			hazard_hook* unprotected = nullptr;
+			{
+				auto records_guard = records->lock();
+				auto guard = orphans.lock();
+				hazard_hook* keep = nullptr;
+				while (auto* hook = guard->head) {
+					guard->head = hook->next;
+					if (is_protected(*records_guard, hook)) {
+						hook->next = keep;
+						keep = hook;
+					}
+					else {
+						hook->next = unprotected;
+						unprotected = hook;
+					}
+				}
+				guard->head = keep;
+			}
+			return reclaim_all(unprotected);
+		}
+
+		// Number of retired objects that haven't been reclaimed yet.
+		[[nodiscard]] size_t get_unreclaimed() const {
+			return unreclaimed->load(memory_order::relaxed);
+		}
+
+	private:
+		using record_list = list<thread_record, &thread_record::hook>;
+
+		// Runs the callbacks of objects that were found unprotected, without holding any lock
+		// so they are free to do arbitrary work including retiring through the domain again.
+		size_t reclaim_all(hazard_hook* list) {
+			size_t reclaimed = 0;
+			while (auto* hook = list) {
+				list = hook->next;
+				hook->reclaim(hook, context);
+				++reclaimed;
+			}
+			unreclaimed->fetch_sub(reclaimed, memory_order::relaxed);
+			return reclaimed;
+		}
+
+		static bool is_protected(record_list& list, hazard_hook* hook) {
+			for (auto& record : list) {
+				for (auto& slot : record.slots) {
+					if (slot.load(memory_order::acquire) == hook) {
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		struct Orphans {
+			hazard_hook* head;
+		};
+
+		cache_padded<spinlock<record_list>> records {};
+		spinlock<Orphans> orphans {};
+		cache_padded<atomic<size_t>> unreclaimed {};
+		void* context;
+		size_t scan_threshold;
+	};
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#include "futex.hpp"
+
+namespace hz {
+	// Single use countdown, threads waiting on it are released once the count reaches zero.
+	// Waiters spin briefly and then sleep through Waiter, spin_waiter makes them spin only.
+	template<futex_waiter Waiter = default_futex_waiter>
+	class latch {
+	public:
+		constexpr explicit latch(uint32_t count) : counter {count} {}
+
+		latch(const latch&) = delete;
+		latch& operator=(const latch&) = delete;
+
+		// Decrements the count by n, which must not exceed the remaining count.
+		void count_down(uint32_t n = 1) {
+			if (counter.fetch_sub(n, memory_order::release) == n) {
+				counter.template notify_all<Waiter>();
+			}
+		}
+
+		[[nodiscard]] bool try_wait() const {
+			return !counter.load(memory_order::acquire);
+		}
+
+		void wait() const {
+			while (auto count = counter.load(memory_order::acquire)) {
+				counter.template wait<Waiter>(count, memory_order::acquire);
+			}
+		}
+
+		void arrive_and_wait(uint32_t n = 1) {
+			count_down(n);
+			wait();
+		}
+
+	private:
+		atomic<uint32_t> counter;
+	};
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+
+namespace hz {
+	// Contention statistics recorded by locks, record is called with the lock held.
+	// contended is set if the first attempt to take the lock failed, even if it didn't have to wait after that.
+	template<typename T>
+	concept lock_stats_policy = requires(T stats, bool contended, uint64_t spins) {
+		stats.record(contended, spins);
+	};
+
+	struct no_lock_stats {
+		void record(bool, uint64_t) {}
+	};
+
+	// Counts acquisitions, acquisitions that had to wait and the total wait iterations.
+	// Only the lock owner writes the counters so they can be read racily at any time.
+	struct lock_stats {
+		void record(bool was_contended, uint64_t spins) {
+			acquisitions.store(acquisitions.load(memory_order::relaxed) + 1, memory_order::relaxed);
+			if (was_contended) {
+				contended.store(contended.load(memory_order::relaxed) + 1, memory_order::relaxed);
+			}
+			total_spins.store(total_spins.load(memory_order::relaxed) + spins, memory_order::relaxed);
+		}
+
+		[[nodiscard]] uint64_t get_acquisitions() const {
+			return acquisitions.load(memory_order::relaxed);
+		}
+
+		[[nodiscard]] uint64_t get_contended() const {
+			return contended.load(memory_order::relaxed);
+		}
+
+		[[nodiscard]] uint64_t get_spins() const {
+			return total_spins.load(memory_order::relaxed);
+		}
+
+	private:
+		atomic<uint64_t> acquisitions {};
+		atomic<uint64_t> contended {};
+		atomic<uint64_t> total_spins {};
+	};
+}
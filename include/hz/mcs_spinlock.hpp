@@ -0,0 +1,133 @@
+#pragma once
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	namespace __detail {
+		struct alignas(hardware_destructive_interference_size) mcs_node {
+			atomic<mcs_node*> next {};
+			atomic<bool> locked {};
+		};
+
+		inline void mcs_acquire(atomic<mcs_node*>& tail, mcs_node& node) {
+			node.next.store(nullptr, memory_order::relaxed);
+			node.locked.store(true, memory_order::relaxed);
+
+			auto* prev = tail.exchange(&node, memory_order::acq_rel);
+			if (!prev) {
+				return;
+			}
+
+			prev->next.store(&node, memory_order::release);
+			while (node.locked.load(memory_order::acquire)) {
+				cpu_relax();
+			}
+		}
+
+		inline void mcs_release(atomic<mcs_node*>& tail, mcs_node& node) {
+			auto* next = node.next.load(memory_order::acquire);
+			if (!next) {
+				if (tail.compare_exchange_strong(&node, nullptr, memory_order::release, memory_order::relaxed)) {
+					return;
+				}
+				// a waiter swapped itself into the tail but hasn't linked itself yet
+				while (!(next = node.next.load(memory_order::acquire))) {
+					cpu_relax();
+				}
+			}
+			next->locked.store(false, memory_order::release);
+		}
+	}
+
+	// Queue spinlock where every waiter spins on the queue node in its own guard,
+	// so waiting doesn't bounce the cache line of the lock. Waiters get the lock in fifo order.
+	// The guard holds the queue node, so it can't be moved.
+	template<typename T>
+	class mcs_spinlock {
+	public:
+		constexpr mcs_spinlock() = default;
+
+		constexpr mcs_spinlock(T&& data) : value {std::move(data)} {} // NOLINT(*-explicit-constructor)
+		constexpr mcs_spinlock(const T& data) : value {data} {} // NOLINT(*-explicit-constructor)
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				__detail::mcs_release(owner->tail, node);
+			}
+
+			operator T&() { // NOLINT(*-explicit-constructor)
+				return owner->value;
+			}
+
+			T& operator*() {
+				return owner->value;
+			}
+
+			T* operator->() {
+				return &owner->value;
+			}
+
+		private:
+			friend mcs_spinlock;
+
+			explicit guard(mcs_spinlock* owner) : owner {owner} {
+				__detail::mcs_acquire(owner->tail, node);
+			}
+
+			mcs_spinlock* owner;
+			__detail::mcs_node node;
+		};
+
+		[[nodiscard]] guard lock() {
+			return guard {this};
+		}
+
+		T& get_unsafe() {
+			return value;
+		}
+
+	private:
+		T value {};
+		atomic<__detail::mcs_node*> tail {};
+	};
+
+	template<>
+	class mcs_spinlock<void> {
+	public:
+		constexpr mcs_spinlock() = default;
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				__detail::mcs_release(owner->tail, node);
+			}
+
+		private:
+			friend mcs_spinlock;
+
+			explicit guard(mcs_spinlock* owner) : owner {owner} {
+				__detail::mcs_acquire(owner->tail, node);
+			}
+
+			mcs_spinlock* owner;
+			__detail::mcs_node node;
+		};
+
+		[[nodiscard]] guard lock() {
+			return guard {this};
+		}
+
+	private:
+		atomic<__detail::mcs_node*> tail {};
+	};
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.hpp"
+#include "atomic.hpp"
+#include "bit.hpp"
+#include "cache_padded.hpp"
+#include "optional.hpp"
+#if __STDC_HOSTED__ == 1
+#include <new>
+#include <utility>
+#else
+#include "new.hpp"
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Bounded multi producer multi consumer queue (Vyukov). Every cell has a sequence number telling
+	// whether it is ready to be written or read for the current lap, so producers and consumers only
+	// contend on their own position counter. The capacity is rounded up to a power of two, if the
+	// allocation fails it is zero.
+	// With Blocking push and pop sleep through atomic::wait while the queue is full or empty,
+	// which costs successful operations a fence to check for sleepers.
+	template<typename T, Allocator Allocator, bool Blocking = false>
+	class mpmc_queue {
+	public:
+		mpmc_queue(size_t capacity, Allocator alloc) : alloc {std::move(alloc)} {
+			capacity = capacity <= 2 ? 2 : bit_ceil(capacity);
+			cells = static_cast<Cell*>(this->alloc.allocate(capacity * sizeof(Cell)));
+			if (!cells) {
+				return;
+			}
+
+			mask = capacity - 1;
+			for (size_t i = 0; i < capacity; ++i) {
+				new (&cells[i]) Cell {};
+				cells[i].sequence.store(i, memory_order::relaxed);
+			}
+		}
+
+		mpmc_queue(const mpmc_queue&) = delete;
+		mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+		~mpmc_queue() {
+			if (!cells) {
+				return;
+			}
+
+			while (try_pop());
+			for (size_t i = 0; i <= mask; ++i) {
+				cells[i].~Cell();
+			}
+			if constexpr (SizedAllocator<Allocator>) {
+				alloc.deallocate(cells, (mask + 1) * sizeof(Cell));
+			}
+			else {
+				alloc.deallocate(cells);
+			}
+		}
+
+		bool try_push(T value) {
+			return try_push_impl(value);
+		}
+
+		optional<T> try_pop() {
+			if (!cells) {
+				return nullopt;
+			}
+
+			auto pos = dequeue_pos->load(memory_order::relaxed);
+			Cell* cell;
+			while (true) {
+				cell = &cells[pos & mask];
+				auto seq = cell->sequence.load(memory_order::acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+				if (!diff) {
+					if (dequeue_pos->compare_exchange_weak(pos, pos + 1, memory_order::relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return nullopt;
+				}
+				else {
+					pos = dequeue_pos->load(memory_order::relaxed);
+				}
+			}
+
+			auto* ptr = std::launder(reinterpret_cast<T*>(cell->storage));
+			optional<T> value {std::move(*ptr)};
+			ptr->~T();
+			cell->sequence.store(pos + mask + 1, memory_order::release);
+			wake(*not_full);
+			return value;
+		}
+
+		// Waits for a free cell.
+		void push(T value) requires(Blocking) {
+			block(*not_full, [&] {
+				return try_push_impl(value);
+			});
+		}
+
+		// Waits for a value.
+		T pop() requires(Blocking) {
+			return std::move(*block(*not_empty, [&] {
+				return try_pop();
+			}));
+		}
+
+		[[nodiscard]] size_t get_capacity() const {
+			return cells ? mask + 1 : 0;
+		}
+
+	private:
+		struct Cell {
+			atomic<size_t> sequence;
+			alignas(T) char storage[sizeof(T)];
+		};
+
+		struct WaitState {
+			atomic<uint32_t> epoch {};
+			atomic<uint32_t> sleepers {};
+		};
+
+		// Only moves from value if the push succeeds.
+		bool try_push_impl(T& value) {
+			if (!cells) {
+				return false;
+			}
+
+			auto pos = enqueue_pos->load(memory_order::relaxed);
+			Cell* cell;
+			while (true) {
+				cell = &cells[pos & mask];
+				auto seq = cell->sequence.load(memory_order::acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+				if (!diff) {
+					if (enqueue_pos->compare_exchange_weak(pos, pos + 1, memory_order::relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = enqueue_pos->load(memory_order::relaxed);
+				}
+			}
+
+			new (cell->storage) T {std::move(value)};
+			cell->sequence.store(pos + 1, memory_order::release);
+			wake(*not_empty);
+			return true;
+		}
+
+		template<typename F>
+		static auto block(WaitState& state, F attempt) {
+			while (true) {
+				if (auto result = attempt()) {
+					return result;
+				}
+
+				state.sleepers.fetch_add(1, memory_order::seq_cst);
+				// pairs with the fence in wake, either the attempt succeeds or the waker sees the sleeper
+				atomic_thread_fence(memory_order::seq_cst);
+				auto epoch = state.epoch.load(memory_order::acquire);
+				if (auto result = attempt()) {
+					state.sleepers.fetch_sub(1, memory_order::relaxed);
+					return result;
+				}
+				state.epoch.wait(epoch, memory_order::acquire);
+				state.sleepers.fetch_sub(1, memory_order::relaxed);
+			}
+		}
+
+		static void wake(WaitState& state) {
+			if constexpr (Blocking) {
+				atomic_thread_fence(memory_order::seq_cst);
+				if (state.sleepers.load(memory_order::relaxed)) {
+					state.epoch.fetch_add(1, memory_order::release);
+					state.epoch.notify_all();
+				}
+			}
+		}
+
+		Cell* cells {};
+		size_t mask {};
+		cache_padded<atomic<size_t>> enqueue_pos {};
+		cache_padded<atomic<size_t>> dequeue_pos {};
+		cache_padded<WaitState> not_empty {};
+		cache_padded<WaitState> not_full {};
+		Allocator alloc;
+	};
+}
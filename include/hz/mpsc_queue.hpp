@@ -0,0 +1,80 @@
+#pragma once
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "double_list.hpp"
+
+namespace hz {
+	// Intrusive multi producer single consumer queue (Vyukov). Pushing is a single exchange and never
+	// allocates or blocks, so it can be used from interrupt handlers. The hook's next pointer is only
+	// accessed atomically while the value is queued, prev is unused.
+	// The queue itself owns a stub hook that is requeued whenever the consumer drains the last value.
+	template<typename T, list_hook (T::*Hook)>
+	class mpsc_queue {
+	public:
+		mpsc_queue() : head {&stub}, tail {&stub} {}
+
+		mpsc_queue(const mpsc_queue&) = delete;
+		mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+		// Safe to call from any thread.
+		void push(T* value) {
+			push_node(value);
+		}
+
+		// Consumer only. Returns null if the queue is empty or if the next value is still being pushed,
+		// in which case it is returned by a later pop.
+		T* pop() {
+			void* node = tail;
+			void* next = next_of(node).load(memory_order::acquire);
+			if (node == &stub) {
+				if (!next) {
+					return nullptr;
+				}
+				tail = next;
+				node = next;
+				next = next_of(next).load(memory_order::acquire);
+			}
+
+			if (next) {
+				tail = next;
+				return static_cast<T*>(node);
+			}
+
+			if (node != head->load(memory_order::acquire)) {
+				return nullptr;
+			}
+
+			push_node(&stub);
+			next = next_of(node).load(memory_order::acquire);
+			if (next) {
+				tail = next;
+				return static_cast<T*>(node);
+			}
+			return nullptr;
+		}
+
+		// Consumer only.
+		[[nodiscard]] bool empty() {
+			return tail == &stub && !next_of(&stub).load(memory_order::acquire);
+		}
+
+	private:
+		// Nodes are either values or the stub, which can't alias a value.
+		atomic_ref<void*> next_of(void* node) {
+			if (node == &stub) {
+				return atomic_ref<void*> {stub.next};
+			}
+			return atomic_ref<void*> {(static_cast<T*>(node)->*Hook).next};
+		}
+
+		void push_node(void* node) {
+			next_of(node).store(nullptr, memory_order::relaxed);
+			auto* prev = head->exchange(node, memory_order::acq_rel);
+			next_of(prev).store(node, memory_order::release);
+		}
+
+		cache_padded<atomic<void*>> head;
+		void* tail;
+		list_hook stub {};
+	};
+}
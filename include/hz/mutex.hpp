@@ -0,0 +1,171 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#include "futex.hpp"
+#include "optional.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	namespace __detail {
+		// The state is 0 when unlocked, 1 when locked and 2 when locked with possible sleepers,
+		// so an unlock without contention doesn't need to call into the waiter.
+		template<futex_waiter Waiter>
+		class mutex_state {
+		public:
+			void lock() {
+				uint32_t value = 0;
+				if (state.compare_exchange_strong(value, 1, memory_order::acquire, memory_order::relaxed)) {
+					return;
+				}
+
+				for (uint32_t i = 0; i < SPIN_COUNT && value != 2; ++i) {
+					cpu_relax();
+					value = state.load(memory_order::relaxed);
+					if (!value && state.compare_exchange_strong(
+						value,
+						1,
+						memory_order::acquire,
+						memory_order::relaxed)) {
+						return;
+					}
+				}
+
+				if (value != 2) {
+					value = state.exchange(2, memory_order::acquire);
+				}
+				while (value) {
+					Waiter::wait(state.data(), 2);
+					value = state.exchange(2, memory_order::acquire);
+				}
+			}
+
+			bool try_lock() {
+				uint32_t value = 0;
+				return state.compare_exchange_strong(value, 1, memory_order::acquire, memory_order::relaxed);
+			}
+
+			void unlock() {
+				if (state.exchange(0, memory_order::release) == 2) {
+					Waiter::wake_one(state.data());
+				}
+			}
+
+		private:
+			static constexpr uint32_t SPIN_COUNT = 100;
+
+			atomic<uint32_t> state {};
+		};
+	}
+
+	// Lock that spins briefly and then sleeps through Waiter,
+	// by default a futex on hosted linux and a busy wait elsewhere.
+	template<typename T, futex_waiter Waiter = default_futex_waiter>
+	class mutex {
+	public:
+		constexpr mutex() = default;
+
+		constexpr mutex(T&& data) : value {std::move(data)} {} // NOLINT(*-explicit-constructor)
+		constexpr mutex(const T& data) : value {data} {} // NOLINT(*-explicit-constructor)
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			constexpr guard(guard&& other) noexcept : owner {other.owner} {
+				other.owner = nullptr;
+			}
+
+			inline ~guard() {
+				if (owner) {
+					owner->state.unlock();
+				}
+			}
+
+			operator T&() { // NOLINT(*-explicit-constructor)
+				return owner->value;
+			}
+
+			T& operator*() {
+				return owner->value;
+			}
+
+			T* operator->() {
+				return &owner->value;
+			}
+
+		private:
+			friend mutex;
+
+			constexpr explicit guard(mutex* owner) : owner {owner} {}
+
+			mutex* owner;
+		};
+
+		[[nodiscard]] guard lock() {
+			state.lock();
+			return guard {this};
+		}
+
+		[[nodiscard]] optional<guard> try_lock() {
+			if (!state.try_lock()) {
+				return nullopt;
+			}
+			return guard {this};
+		}
+
+		T& get_unsafe() {
+			return value;
+		}
+
+	private:
+		T value {};
+		__detail::mutex_state<Waiter> state {};
+	};
+
+	template<futex_waiter Waiter>
+	class mutex<void, Waiter> {
+	public:
+		constexpr mutex() = default;
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			constexpr guard(guard&& other) noexcept : owner {other.owner} {
+				other.owner = nullptr;
+			}
+
+			inline ~guard() {
+				if (owner) {
+					owner->state.unlock();
+				}
+			}
+
+		private:
+			friend mutex;
+
+			constexpr explicit guard(mutex* owner) : owner {owner} {}
+
+			mutex* owner;
+		};
+
+		[[nodiscard]] guard lock() {
+			state.lock();
+			return guard {this};
+		}
+
+		[[nodiscard]] optional<guard> try_lock() {
+			if (!state.try_lock()) {
+				return nullopt;
+			}
+			return guard {this};
+		}
+
+	private:
+		__detail::mutex_state<Waiter> state {};
+	};
+}
@@ -116,7 +116,7 @@ namespace hz {
 		}
 
 		constexpr const T* operator->() const noexcept {
-			return std::launder(reinterpret_cast<T*>(data));
+			return std::launder(reinterpret_cast<const T*>(data));
 		}
 
 		constexpr T& operator*() & noexcept {
@@ -124,7 +124,7 @@ namespace hz {
 		}
 
 		constexpr const T& operator*() const & noexcept {
-			return *std::launder(reinterpret_cast<T*>(data));
+			return *std::launder(reinterpret_cast<const T*>(data));
 		}
 
 		constexpr T&& operator*() && noexcept {
@@ -132,7 +132,7 @@ namespace hz {
 		}
 
 		constexpr const T&& operator*() const && noexcept {
-			return std::move(*std::launder(reinterpret_cast<T*>(data)));
+			return std::move(*std::launder(reinterpret_cast<const T*>(data)));
 		}
 
 		constexpr explicit operator bool() const noexcept {
@@ -148,7 +148,7 @@ namespace hz {
 		}
 
 		constexpr const T& value() const & {
-			return *std::launder(reinterpret_cast<T*>(data));
+			return *std::launder(reinterpret_cast<const T*>(data));
 		}
 
 		constexpr T&& value() && {
@@ -156,7 +156,7 @@ namespace hz {
 		}
 
 		constexpr const T&& value() const && {
-			return std::move(*std::launder(reinterpret_cast<T*>(data)));
+			return std::move(*std::launder(reinterpret_cast<const T*>(data)));
 		}
 
 		constexpr void reset() noexcept {
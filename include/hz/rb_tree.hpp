@@ -24,6 +24,13 @@ namespace hz {
 		T::ensure_fail("", "", 0, "");
 	};
 
+	template<typename K>
+	concept rb_tree_key = requires(K lhs, K rhs) {
+		lhs < rhs;
+		lhs > rhs;
+		lhs == rhs;
+	};
+
 #define hz_assert(expr) ((expr) ? ((void) 0) : Verifier::ensure_fail(#expr, __FILE__, __LINE__, __func__))
 
 	template<typename T, rb_tree_hook (T::*Hook), verifier Verifier = trap_verifier>
@@ -78,6 +85,60 @@ namespace hz {
 			return node;
 		}
 
+		// Walks the nodes in order through the successor links. The next node is read before
+		// the current one is visited, so the current node may be removed.
+		class iterator {
+		private:
+			constexpr explicit iterator(T* ptr) : ptr {ptr}, next {ptr ? get_successor(ptr) : nullptr} {}
+
+			T* ptr;
+			T* next;
+			friend class rb_tree_base;
+		public:
+			constexpr bool operator!=(const iterator& other) const {
+				return ptr != other.ptr;
+			}
+
+			constexpr iterator& operator++() {
+				ptr = next;
+				if (ptr) {
+					next = get_successor(ptr);
+				}
+
+				return *this;
+			}
+
+			constexpr T& operator*() {
+				return *ptr;
+			}
+		};
+
+		// Nodes from first up to but excluding last, which may be null for the end of the tree.
+		class node_range {
+		public:
+			constexpr node_range(T* first, T* last) : first {first}, last {last} {}
+
+			constexpr iterator begin() const {
+				return iterator {first};
+			}
+
+			constexpr iterator end() const {
+				return iterator {last};
+			}
+
+		private:
+			T* first;
+			T* last;
+		};
+
+		constexpr iterator begin() {
+			return iterator {get_first()};
+		}
+
+		constexpr iterator end() {
+			return iterator {nullptr};
+		}
+
 		constexpr void remove(T* node) {
 			T* left = static_cast<T*>((node->*Hook).child[0]);
 			T* right = static_cast<T*>((node->*Hook).child[1]);
@@ -419,11 +480,7 @@ namespace hz {
 			return true;
 		}
 
-		template<typename K, K (T::*Key)> requires requires(K lhs, K rhs) {
-			lhs < rhs;
-			lhs > rhs;
-			lhs == rhs;
-		}
+		template<rb_tree_key K, K (T::*Key)>
 		constexpr T* find(K key) {
 			auto* n = this->get_root();
 
@@ -445,6 +502,68 @@ namespace hz {
 
 			return nullptr;
 		}
+
+		// First node whose key is not smaller than key.
+		template<rb_tree_key K, K (T::*Key)>
+		constexpr T* lower_bound(K key) {
+			T* result = nullptr;
+			auto* n = this->get_root();
+			while (n) {
+				if ((n->*Key) < key) {
+					n = rb_tree_base<T, Hook>::get_right(n);
+				}
+				else {
+					result = n;
+					n = rb_tree_base<T, Hook>::get_left(n);
+				}
+			}
+			return result;
+		}
+
+		// First node whose key is greater than key.
+		template<rb_tree_key K, K (T::*Key)>
+		constexpr T* upper_bound(K key) {
+			T* result = nullptr;
+			auto* n = this->get_root();
+			while (n) {
+				if (key < (n->*Key)) {
+					result = n;
+					n = rb_tree_base<T, Hook>::get_left(n);
+				}
+				else {
+					n = rb_tree_base<T, Hook>::get_right(n);
+				}
+			}
+			return result;
+		}
+
+		// Last node whose key is not greater than key, e.g. the region containing an address.
+		template<rb_tree_key K, K (T::*Key)>
+		constexpr T* find_le(K key) {
+			T* result = nullptr;
+			auto* n = this->get_root();
+			while (n) {
+				if (key < (n->*Key)) {
+					n = rb_tree_base<T, Hook>::get_left(n);
+				}
+				else {
+					result = n;
+					n = rb_tree_base<T, Hook>::get_right(n);
+				}
+			}
+			return result;
+		}
+
+		// Nodes with keys in [from, to) in order. Only descends the tree twice, the nodes in between
+		// are reached through the successor links. The node at to must not be removed while iterating.
+		template<rb_tree_key K, K (T::*Key)>
+		constexpr typename rb_tree_base<T, Hook, Verifier>::node_range range(K from, K to) {
+			auto* first = lower_bound<K, Key>(from);
+			if (first && !((first->*Key) < to)) {
+				first = nullptr;
+			}
+			return {first, first ? lower_bound<K, Key>(to) : nullptr};
+		}
 	};
 
 #undef hz_assert
@@ -0,0 +1,216 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "shard.hpp"
+#include "cache_padded.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	namespace __detail {
+		// Readers are counted in Shards separate cache lines, writers in a single word
+		// holding the number of waiting writers shifted by one and the locked bit.
+		// New readers back off while any writer is waiting, so writers can't be starved.
+		template<size_t Shards, shard_index ShardIndex>
+		class rw_spinlock_state {
+		public:
+			size_t lock_shared() {
+				size_t shard = Shards == 1 ? 0 : static_cast<size_t>(ShardIndex::get()) % Shards;
+				auto& readers = *reader_shards[shard];
+				while (true) {
+					readers.fetch_add(1, memory_order::seq_cst);
+					if (!writer->load(memory_order::seq_cst)) {
+						return shard;
+					}
+
+					readers.fetch_sub(1, memory_order::relaxed);
+					while (writer->load(memory_order::relaxed)) {
+						cpu_relax();
+					}
+				}
+			}
+
+			void unlock_shared(size_t shard) {
+				reader_shards[shard]->fetch_sub(1, memory_order::release);
+			}
+
+			void lock() {
+				auto value = writer->fetch_add(WAITING_WRITER, memory_order::seq_cst);
+				while (true) {
+					if (!(value & LOCKED) && writer->compare_exchange_weak(
+						value,
+						value - WAITING_WRITER + LOCKED,
+						memory_order::seq_cst,
+						memory_order::relaxed)) {
+						break;
+					}
+					cpu_relax();
+					value = writer->load(memory_order::relaxed);
+				}
+
+				for (auto& shard : reader_shards) {
+					while (shard->load(memory_order::acquire)) {
+						cpu_relax();
+					}
+				}
+			}
+
+			void unlock() {
+				writer->fetch_sub(LOCKED, memory_order::release);
+			}
+
+		private:
+			static constexpr uint32_t LOCKED = 1;
+			static constexpr uint32_t WAITING_WRITER = 2;
+
+			cache_padded<atomic<uint32_t>> reader_shards[Shards] {};
+			cache_padded<atomic<uint32_t>> writer {};
+		};
+	}
+
+	// Reader-writer spinlock, lock_shared gives read only access shared with other readers
+	// and lock gives exclusive access. With Shards > 1 readers are spread over that many counters
+	// picked by ShardIndex so they don't bounce a single cache line between each other,
+	// at the cost of writers having to check every counter.
+	template<typename T, size_t Shards = 1, shard_index ShardIndex = default_shard_index>
+	class rw_spinlock {
+	public:
+		static_assert(Shards > 0);
+
+		constexpr rw_spinlock() = default;
+
+		constexpr rw_spinlock(T&& data) : value {std::move(data)} {} // NOLINT(*-explicit-constructor)
+		constexpr rw_spinlock(const T& data) : value {data} {} // NOLINT(*-explicit-constructor)
+
+		struct shared_guard {
+			constexpr shared_guard(const shared_guard&) = delete;
+			constexpr shared_guard& operator=(const shared_guard&) = delete;
+
+			inline ~shared_guard() {
+				owner->state.unlock_shared(shard);
+			}
+
+			operator const T&() const { // NOLINT(*-explicit-constructor)
+				return owner->value;
+			}
+
+			const T& operator*() const {
+				return owner->value;
+			}
+
+			const T* operator->() const {
+				return &owner->value;
+			}
+
+		private:
+			friend rw_spinlock;
+
+			constexpr shared_guard(const rw_spinlock* owner, size_t shard) : owner {owner}, shard {shard} {}
+
+			const rw_spinlock* owner;
+			size_t shard;
+		};
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				owner->state.unlock();
+			}
+
+			operator T&() { // NOLINT(*-explicit-constructor)
+				return owner->value;
+			}
+
+			T& operator*() {
+				return owner->value;
+			}
+
+			T* operator->() {
+				return &owner->value;
+			}
+
+		private:
+			friend rw_spinlock;
+
+			constexpr explicit guard(rw_spinlock* owner) : owner {owner} {}
+
+			rw_spinlock* owner;
+		};
+
+		[[nodiscard]] shared_guard lock_shared() const {
+			return shared_guard {this, state.lock_shared()};
+		}
+
+		[[nodiscard]] guard lock() {
+			state.lock();
+			return guard {this};
+		}
+
+		T& get_unsafe() {
+			return value;
+		}
+
+	private:
+		T value {};
+		mutable __detail::rw_spinlock_state<Shards, ShardIndex> state {};
+	};
+
+	template<size_t Shards, shard_index ShardIndex>
+	class rw_spinlock<void, Shards, ShardIndex> {
+	public:
+		static_assert(Shards > 0);
+
+		constexpr rw_spinlock() = default;
+
+		struct shared_guard {
+			constexpr shared_guard(const shared_guard&) = delete;
+			constexpr shared_guard& operator=(const shared_guard&) = delete;
+
+			inline ~shared_guard() {
+				owner->state.unlock_shared(shard);
+			}
+
+		private:
+			friend rw_spinlock;
+
+			constexpr shared_guard(const rw_spinlock* owner, size_t shard) : owner {owner}, shard {shard} {}
+
+			const rw_spinlock* owner;
+			size_t shard;
+		};
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				owner->state.unlock();
+			}
+
+		private:
+			friend rw_spinlock;
+
+			constexpr explicit guard(rw_spinlock* owner) : owner {owner} {}
+
+			rw_spinlock* owner;
+		};
+
+		[[nodiscard]] shared_guard lock_shared() const {
+			return shared_guard {this, state.lock_shared()};
+		}
+
+		[[nodiscard]] guard lock() {
+			state.lock();
+			return guard {this};
+		}
+
+	private:
+		mutable __detail::rw_spinlock_state<Shards, ShardIndex> state {};
+	};
+}
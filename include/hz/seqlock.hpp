@@ -0,0 +1,107 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "type_traits.hpp"
+#if __STDC_HOSTED__ == 1
+#include <new>
+#else
+#include "new.hpp"
+#endif
+
+namespace hz {
+	// Sequence lock for small trivially copyable data that is read far more often than written.
+	// Readers never write shared memory, they copy the data and retry if a writer was active meanwhile.
+	// The data is stored as relaxed atomic words so the racy copy is well defined.
+	template<typename T> requires is_trivially_copyable_v<T>
+	class seqlock {
+	public:
+		constexpr seqlock() = default;
+
+		explicit seqlock(const T& value) {
+			store_words(value);
+		}
+
+		[[nodiscard]] T read() const {
+			Words words;
+			while (true) {
+				auto start = seq.load(memory_order::acquire);
+				if (start & 1) {
+					cpu_relax();
+					continue;
+				}
+
+				for (size_t i = 0; i < WORD_COUNT; ++i) {
+					words.words[i] = data[i].load(memory_order::relaxed);
+				}
+				// keeps the data loads above from moving below the second sequence load
+				atomic_thread_fence(memory_order::acquire);
+
+				if (seq.load(memory_order::relaxed) == start) {
+					return words.get();
+				}
+			}
+		}
+
+		void write(const T& value) {
+			auto start = begin_write();
+			store_words(value);
+			seq.store(start + 2, memory_order::release);
+		}
+
+		// Modifies the current value in place, writers are serialized so no update is lost.
+		template<typename F>
+		void update(F fn) {
+			auto start = begin_write();
+			Words words;
+			for (size_t i = 0; i < WORD_COUNT; ++i) {
+				words.words[i] = data[i].load(memory_order::relaxed);
+			}
+			T value = words.get();
+			fn(value);
+			store_words(value);
+			seq.store(start + 2, memory_order::release);
+		}
+
+	private:
+		static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+		struct Words {
+			T get() const {
+				alignas(T) unsigned char storage[sizeof(T)];
+				__builtin_memcpy(storage, words, sizeof(T));
+				return *std::launder(reinterpret_cast<T*>(storage));
+			}
+
+			uintptr_t words[WORD_COUNT];
+		};
+
+		// Makes the sequence odd, which also locks out other writers.
+		uint32_t begin_write() {
+			while (true) {
+				auto start = seq.load(memory_order::relaxed);
+				if (!(start & 1) && seq.compare_exchange_weak(
+					start,
+					start + 1,
+					memory_order::acquire,
+					memory_order::relaxed)) {
+					// keeps the data stores from moving above the sequence increment
+					atomic_thread_fence(memory_order::release);
+					return start;
+				}
+				cpu_relax();
+			}
+		}
+
+		void store_words(const T& value) {
+			Words words {};
+			__builtin_memcpy(words.words, &value, sizeof(T));
+			for (size_t i = 0; i < WORD_COUNT; ++i) {
+				data[i].store(words.words[i], memory_order::relaxed);
+			}
+		}
+
+		atomic<uint32_t> seq {};
+		atomic<uintptr_t> data[WORD_COUNT] {};
+	};
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+
+namespace hz {
+	// Picks the shard the calling thread or cpu should use, e.g. the current cpu number in a kernel.
+	// The index may change between calls and is reduced modulo the shard count by the user.
+	template<typename T>
+	concept shard_index = requires(T) {
+		static_cast<size_t>(T::get());
+	};
+
+	// Always uses the first shard.
+	struct single_shard_index {
+		static size_t get() {
+			return 0;
+		}
+	};
+
+#if __STDC_HOSTED__ == 1
+	// Hands out indices to threads round robin on their first use.
+	struct thread_shard_index {
+		static size_t get() {
+			static atomic<size_t> next_index {};
+			thread_local size_t index = next_index.fetch_add(1, memory_order::relaxed);
+			return index;
+		}
+	};
+
+	using default_shard_index = thread_shard_index;
+#else
+	using default_shard_index = single_shard_index;
+#endif
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "shard.hpp"
+
+namespace hz {
+	// Counter split over Shards cache lines so frequent updates from different threads or cpus
+	// don't contend on a single line. Updates are relaxed and only touch the caller's shard,
+	// read sums all shards and is only exact while there are no concurrent updates.
+	// Shards may be shared by multiple threads, so the increments are still atomic.
+	template<size_t Shards = 16, shard_index ShardIndex = default_shard_index>
+	class sharded_counter {
+	public:
+		static_assert(Shards > 0);
+
+		constexpr sharded_counter() = default;
+
+		sharded_counter(const sharded_counter&) = delete;
+		sharded_counter& operator=(const sharded_counter&) = delete;
+
+		void add(uint64_t value) {
+			size_t shard = Shards == 1 ? 0 : static_cast<size_t>(ShardIndex::get()) % Shards;
+			shards[shard]->fetch_add(value, memory_order::relaxed);
+		}
+
+		// The total wraps around like an unsigned integer, so it can be used as a gauge
+		// as long as every subtraction follows a matching addition.
+		void sub(uint64_t value) {
+			add(-value);
+		}
+
+		void increment() {
+			add(1);
+		}
+
+		[[nodiscard]] uint64_t read() const {
+			uint64_t total = 0;
+			for (auto& shard : shards) {
+				total += shard->load(memory_order::relaxed);
+			}
+			return total;
+		}
+
+	private:
+		cache_padded<atomic<uint64_t>> shards[Shards] {};
+	};
+}
@@ -6,6 +6,7 @@
 #include "rb_tree.hpp"
 #include "double_list.hpp"
 #include "spinlock.hpp"
+#include "cache_padded.hpp"
 #include "pair.hpp"
 #include "bit.hpp"
 #if __STDC_HOSTED__ == 1
@@ -32,6 +33,10 @@ namespace hz {
 		static constexpr size_t POW2_SLABS_BEGIN = 2048;
 		static constexpr size_t POW2_SLABS_END = 1024 * 128;
 		static constexpr size_t POW2_ARENA_SIZE = 1024 * 128;
+		// maximum amount of blocks a thread_cache holds per small slab
+		static constexpr size_t THREAD_CACHE_BLOCKS = 32;
+		// significant bits of the addresses returned by the arena allocator
+		static constexpr size_t ADDRESS_BITS = 48;
 	};
 
 	template<typename T>
@@ -50,7 +55,13 @@ namespace hz {
 		}
 	};
 
-	template<SizedAllocator ArenaAllocator, typename Config = default_slab_config, slab_verifier Verifier = slab_trap_verifier>
+	// Lock is the spinlock-like template used for all the internal locks,
+	// e.g. hz::spinlock, hz::ticket_spinlock or hz::mcs_spinlock.
+	template<
+		SizedAllocator ArenaAllocator,
+		typename Config = default_slab_config,
+		slab_verifier Verifier = slab_trap_verifier,
+		template<typename...> typename Lock = spinlock>
 	class slab_allocator {
 	public:
 		constexpr explicit slab_allocator(ArenaAllocator arena_alloc) : arena_alloc {std::move(arena_alloc)} {}
@@ -60,312 +71,588 @@ namespace hz {
 				size = 1;
 			}
 
-			AllocInfo* info;
-			MetadataPage* meta_arena;
-			{
-				auto meta_guard = free_metadatas.lock();
-				if (!meta_guard->is_empty()) {
-					meta_arena = meta_guard->front();
-					++meta_arena->count;
-					info = meta_arena->freelist.pop();
-					if (meta_arena->count == meta_arena->max) {
-						meta_guard->remove(meta_arena);
-					}
+			if (size > Config::POW2_SLABS_END) {
+				// the record describing a large allocation lives in a small slab
+				auto record_index = size_to_small_index(sizeof(Region));
+				auto* record_mem = alloc_block(*free_small_arenas[record_index], small_arena_for(record_index));
+				if (!record_mem) {
+					return nullptr;
 				}
-				else {
-					auto* meta_mem = arena_alloc.allocate(0x1000);
-					if (!meta_mem) {
-						return nullptr;
-					}
-
-					meta_arena = new (meta_mem) MetadataPage {};
-					meta_arena->max = (0x1000 - sizeof(MetadataPage)) / sizeof(AllocInfo);
 
-					for (size_t i = 0; i < meta_arena->max; ++i) {
-						auto* new_info = new (reinterpret_cast<char*>(&meta_arena[1]) + i * sizeof(AllocInfo))
-							AllocInfo {};
-						meta_arena->freelist.push(new_info);
-					}
+				auto* mem = arena_alloc.allocate(size);
+				if (!mem) {
+					release_record(record_mem);
+					return nullptr;
+				}
 
-					++meta_arena->count;
-					info = meta_arena->freelist.pop();
-					if (meta_arena->count != meta_arena->max) {
-						meta_guard->push(meta_arena);
+				auto* record = new (record_mem) Region {
+					.tree_hook {},
+					.start = reinterpret_cast<uintptr_t>(mem),
+					.size = size,
+					.kind = RegionKind::Large
+				};
+
+				bool pinned;
+				{
+					auto guard = regions->lock();
+					// keeps the page map nodes on the path of the first page alive for lookups by the thread cache paths
+					pinned = page_map_pin(record->start >> 12);
+					if (pinned) {
+						guard->insert(record);
 					}
 				}
-			}
-
-			info->metadata_arena = meta_arena;
 
-			if (size > Config::POW2_SLABS_END) {
-				auto* mem = arena_alloc.allocate(size);
-				if (!mem) {
-					auto guard = free_metadatas.lock();
-					meta_arena->freelist.push(info);
-					--meta_arena->count;
+				if (!pinned) {
+					arena_alloc.deallocate(mem, size);
+					release_record(record);
 					return nullptr;
 				}
-
-				info->ptr = mem;
-				info->size = size;
-				allocations.lock()->insert(info);
 				return mem;
 			}
 			else if (size >= Config::POW2_SLABS_BEGIN) {
 				auto index = size_to_pow2_index(size);
+				return alloc_block(*free_pow2_arenas[index], ArenaClass {
+					.kind = RegionKind::Pow2,
+					.index = index,
+					.block_size = pow2_index_to_size(index),
+					.block_count = Config::POW2_ARENA_SIZE / pow2_index_to_size(index)
+				});
+			}
+			else {
+				auto index = size_to_small_index(size);
+				return alloc_block(*free_small_arenas[index], small_arena_for(index));
+			}
+		}
 
-				auto guard = free_pow2_arenas[index].lock();
-				Arena* arena;
-				void* mem;
-				if (!guard->is_empty()) {
-					arena = guard->front();
-					++arena->count;
-					mem = arena->freelist.pop();
-					if (arena->count == arena->max) {
-						guard->remove(arena);
-					}
+		// Like alloc but also returns the usable size of the allocation, which is the block size of the slab it came from.
+		allocation_result alloc_at_least(size_t size) {
+			if (!size) {
+				size = 1;
+			}
+
+			size_t usable = size;
+			if (size <= Config::POW2_SLABS_END) {
+				if (size >= Config::POW2_SLABS_BEGIN) {
+					usable = pow2_index_to_size(size_to_pow2_index(size));
 				}
 				else {
-					auto* arena_mem = arena_alloc.allocate(0x1000 + Config::POW2_ARENA_SIZE);
-					if (!arena_mem) {
-						auto meta_guard = free_metadatas.lock();
-						meta_arena->freelist.push(info);
-						--meta_arena->count;
-						return nullptr;
-					}
+					usable = Config::SMALL_SLABS[size_to_small_index(size)].first;
+				}
+			}
 
-					auto block_size = pow2_index_to_size(index);
+			auto* ptr = alloc(size);
+			return {ptr, ptr ? usable : 0};
+		}
 
-					arena = new (arena_mem) Arena {};
-					arena->max = Config::POW2_ARENA_SIZE / block_size;
+		// Returns the usable size of the allocation, for slab allocations this is the block size of the slab.
+		size_t get_size_for_allocation(void* ptr) {
+			auto guard = regions->lock();
 
-					for (size_t i = 0; i < arena->max; ++i) {
-						auto* hdr = new (static_cast<char*>(arena_mem) + 0x1000 + i * block_size) Header {};
-						arena->freelist.push(hdr);
-					}
+			auto* region = find_region(*guard, ptr);
+			if (!region) {
+				Verifier::double_free_or_corruption();
+				return 0;
+			}
 
-					++arena->count;
-					mem = arena->freelist.pop();
-					if (arena->count != arena->max) {
-						guard->push(arena);
-					}
-				}
+			if (region->kind == RegionKind::Large) {
+				return region->size;
+			}
+			return static_cast<Arena*>(region)->block_size;
+		}
 
-				info->ptr = mem;
-				info->size = size;
-				info->arena = arena;
-				allocations.lock()->insert(info);
-				return mem;
+		void free(void* ptr) {
+			if (!ptr) {
+				return;
 			}
-			else {
-				size_t index = SIZE_MAX;
 
-				for (size_t i = 0; i < Config::SMALL_SLABS.size(); ++i) {
-					const auto& slab_info = Config::SMALL_SLABS[i];
-					if (slab_info.first >= size) {
-						index = i;
-						break;
-					}
-				}
+			Region* region;
+			{
+				auto guard = regions->lock();
 
-				if (index == SIZE_MAX) {
-					Verifier::invalid_config("no small slabs");
-					__builtin_trap();
+				region = find_region(*guard, ptr);
+				if (!region) {
+					Verifier::double_free_or_corruption();
+					return;
 				}
 
-				auto guard = free_small_arenas[index].lock();
-				Arena* arena;
-				void* mem;
-				if (!guard->is_empty()) {
-					arena = guard->front();
-					++arena->count;
-					mem = arena->freelist.pop();
-					if (arena->count == arena->max) {
-						guard->remove(arena);
-					}
+				if (region->kind == RegionKind::Large) {
+					guard->remove(region);
+					page_map_unpin(region->start >> 12);
 				}
-				else {
-					auto block_size = Config::SMALL_SLABS[index].first;
-					auto block_count = Config::SMALL_SLABS[index].second;
-					auto total_size = block_size * block_count;
-					auto* arena_mem = arena_alloc.allocate(0x1000 + total_size);
-					if (!arena_mem) {
-						auto meta_guard = free_metadatas.lock();
-						meta_arena->freelist.push(info);
-						--meta_arena->count;
-						return nullptr;
-					}
+			}
 
-					arena = new (arena_mem) Arena {};
-					arena->max = block_count;
+			if (region->kind == RegionKind::Large) {
+				arena_alloc.deallocate(ptr, region->size);
+				release_record(region);
+				return;
+			}
 
-					for (size_t i = 0; i < arena->max; ++i) {
-						auto* hdr = new (static_cast<char*>(arena_mem) + 0x1000 + i * block_size) Header {};
-						arena->freelist.push(hdr);
-					}
+			auto* arena = static_cast<Arena*>(region);
+			if (!clear_used(arena, ptr)) {
+				Verifier::double_free_or_corruption();
+				return;
+			}
+			release_block(arena, ptr);
+		}
 
-					++arena->count;
-					mem = arena->freelist.pop();
-					if (arena->count != arena->max) {
-						guard->push(arena);
+		class thread_cache;
+
+		// Like alloc but tries the blocks cached by the calling thread first, cache must belong to the calling thread.
+		void* alloc(size_t size, thread_cache& cache) {
+			if (!size) {
+				size = 1;
+			}
+
+			if (size < Config::POW2_SLABS_BEGIN) {
+				auto index = size_to_small_index(size);
+
+				CachedBlock* block;
+				{
+					auto guard = cache.busy.lock();
+					cache.used = true;
+					block = cache.blocks[index];
+					if (block) {
+						cache.blocks[index] = block->next;
+						--cache.counts[index];
 					}
 				}
 
-				info->ptr = mem;
-				info->size = size;
-				info->arena = arena;
-				allocations.lock()->insert(info);
-				return mem;
+				if (block) {
+					set_used(block->arena, block);
+					return block;
+				}
 			}
+
+			return alloc(size);
 		}
 
-		size_t get_size_for_allocation(void* ptr) {
-			auto guard = allocations.lock();
+		// Like free but keeps small blocks in the calling thread's cache, up to THREAD_CACHE_BLOCKS per slab.
+		void free(void* ptr, thread_cache& cache) {
+			if (!ptr) {
+				return;
+			}
+
+			auto* arena = page_map_lookup(ptr);
+			if (!arena) {
+				// large allocations and invalid pointers take the locked path which verifies them
+				free(ptr);
+				return;
+			}
 
-			auto* info = guard->template find<void*, &AllocInfo::ptr>(ptr);
-			if (!info) {
+			if (!clear_used(arena, ptr)) {
 				Verifier::double_free_or_corruption();
+				return;
 			}
 
-			return info->size;
+			if (arena->kind == RegionKind::Small) {
+				auto guard = cache.busy.lock();
+				cache.used = true;
+				if (cache.counts[arena->index] < get_thread_cache_blocks()) {
+					auto& blocks = cache.blocks[arena->index];
+					blocks = new (ptr) CachedBlock {blocks, arena};
+					++cache.counts[arena->index];
+					return;
+				}
+			}
+
+			release_block(arena, ptr);
 		}
 
-		void free(void* ptr) {
-			if (!ptr) {
-				return;
+		// Returns the blocks of every registered thread cache that was not used since the previous
+		// scavenge back to the shared arenas, also when their threads are blocked. Caches that are in
+		// use right now are skipped. Meant to be called periodically, returns the amount of blocks released.
+		size_t scavenge() {
+			size_t released = 0;
+			auto guard = threads->lock();
+			for (auto& cache : *guard) {
+				CachedBlock* blocks[Config::SMALL_SLABS.size()] {};
+				if (auto cache_guard = cache.busy.try_lock()) {
+					if (cache.used) {
+						cache.used = false;
+						continue;
+					}
+					take_cached_blocks(cache, blocks);
+				}
+				released += release_cached_blocks(blocks);
+			}
+			return released;
+		}
+
+	private:
+		struct Header {
+			list_hook hook;
+		};
+
+		enum class RegionKind {
+			Small,
+			Pow2,
+			Large
+		};
+
+		// Address range known to the allocator, either the blocks of an arena or a single large allocation.
+		struct Region {
+			rb_tree_hook tree_hook;
+			uintptr_t start;
+			size_t size;
+			RegionKind kind;
+
+			constexpr bool operator==(const Region& other) const {
+				return start == other.start;
 			}
 
-			AllocInfo* info;
-			{
-				auto guard = allocations.lock();
+			constexpr bool operator>(const Region& other) const {
+				return start > other.start;
+			}
 
-				info = guard->template find<void*, &AllocInfo::ptr>(ptr);
-				if (!info) {
-					Verifier::double_free_or_corruption();
-					return;
+			constexpr bool operator<(const Region& other) const {
+				return start < other.start;
+			}
+		};
+
+		struct ArenaClass {
+			RegionKind kind;
+			size_t index;
+			size_t block_size;
+			size_t block_count;
+		};
+
+		static constexpr size_t get_max_arena_blocks() {
+			size_t max = Config::POW2_ARENA_SIZE / Config::POW2_SLABS_BEGIN;
+			for (const auto& slab_info : Config::SMALL_SLABS) {
+				if (slab_info.second > max) {
+					max = slab_info.second;
 				}
+			}
+			return max;
+		}
+
+		// Lives at the start of the page preceding the blocks of the arena, the size class
+		// and a bit per block used for catching double frees is all the metadata small allocations have.
+		struct Arena : Region {
+			list_hook hook;
+			list<Header, &Header::hook> freelist;
+			size_t max {};
+			size_t count {};
+			size_t index {};
+			size_t block_size {};
+			atomic<uint64_t> used[(get_max_arena_blocks() + 63) / 64] {};
+		};
+
+		static_assert(sizeof(Arena) <= 0x1000, "arena metadata doesn't fit in the arena header page");
+
+		// Blocks kept by a thread_cache remember their arena so taking them out of the cache needs no lookup.
+		struct CachedBlock {
+			CachedBlock* next;
+			Arena* arena;
+		};
+
+		static constexpr size_t get_address_bits() {
+			if constexpr (requires { Config::ADDRESS_BITS; }) {
+				return Config::ADDRESS_BITS;
+			}
+			else {
+				return 48;
+			}
+		}
+
+		// The page map is a radix tree over the pages of the address space which maps the pages spanned by
+		// the blocks of an arena to the arena, it lets the thread cache paths find the arena of a block
+		// without taking the region lock. The blocks of two arenas never share a page as every arena
+		// starts with its header page, so an entry only has to remember which part of the page is covered.
+		// It is modified with the region lock held and read without any lock, which is fine for pointers
+		// that are still allocated because the page map nodes on their path stay in use until they are freed.
+		// The first page of a large allocation pins the nodes on its path for the same reason.
+		static constexpr size_t PAGE_MAP_BITS = 9;
+		static constexpr size_t PAGE_MAP_LEVELS = (get_address_bits() - 12 + PAGE_MAP_BITS - 1) / PAGE_MAP_BITS;
+
+		static_assert(PAGE_MAP_LEVELS >= 2, "ADDRESS_BITS is too small for the page map");
+
+		struct PageNode {
+			// amount of non-null children or pinned entries, only accessed with the region lock held
+			size_t used;
+		};
+
+		struct PageTable : PageNode {
+			atomic<PageNode*> children[size_t {1} << PAGE_MAP_BITS];
+		};
+
+		struct PageEntry {
+			// begin << 16 | end of the covered part of the page, 0 if none
+			atomic<uint32_t> range;
+			atomic<Arena*> arena;
+		};
+
+		struct PageLeaf : PageNode {
+			PageEntry entries[size_t {1} << PAGE_MAP_BITS];
+		};
 
-				guard->remove(info);
+		static constexpr size_t page_map_index(uintptr_t page, size_t level) {
+			return (page >> ((PAGE_MAP_LEVELS - 1 - level) * PAGE_MAP_BITS)) & ((size_t {1} << PAGE_MAP_BITS) - 1);
+		}
+
+		PageLeaf* find_page_leaf(uintptr_t page) {
+			PageNode* node = &page_map;
+			for (size_t level = 0; level < PAGE_MAP_LEVELS - 1 && node; ++level) {
+				node = static_cast<PageTable*>(node)->children[page_map_index(page, level)].load(memory_order::acquire);
+			}
+			return static_cast<PageLeaf*>(node);
+		}
+
+		// Returns the arena ptr is a block of or null if it isn't in an arena, doesn't lock.
+		Arena* page_map_lookup(void* ptr) {
+			auto addr = reinterpret_cast<uintptr_t>(ptr);
+			auto* leaf = find_page_leaf(addr >> 12);
+			if (!leaf) {
+				return nullptr;
+			}
+
+			auto& entry = leaf->entries[page_map_index(addr >> 12, PAGE_MAP_LEVELS - 1)];
+			auto range = entry.range.load(memory_order::acquire);
+			auto offset = addr & 0xFFF;
+			if (offset < (range >> 16) || offset >= (range & 0xFFFF)) {
+				return nullptr;
 			}
 
-			if (info->size > Config::POW2_SLABS_END) {
-				arena_alloc.deallocate(info->ptr, info->size);
+			auto* arena = entry.arena.load(memory_order::relaxed);
+			if ((addr - arena->start) % arena->block_size) {
+				return nullptr;
 			}
-			else if (info->size >= Config::POW2_SLABS_BEGIN) {
-				auto index = size_to_pow2_index(info->size);
-				auto guard = free_pow2_arenas[index].lock();
+			return arena;
+		}
 
-				auto* arena = info->arena;
-				if (arena->count == 1) {
-					if (arena->count != arena->max) {
-						guard->remove(arena);
+		// Creates the path to the leaf of page if needed and marks the entry as used, requires the region lock.
+		PageLeaf* page_map_pin(uintptr_t page) {
+			PageNode* node = &page_map;
+			for (size_t level = 0; level < PAGE_MAP_LEVELS - 1; ++level) {
+				auto& slot = static_cast<PageTable*>(node)->children[page_map_index(page, level)];
+				auto* child = slot.load(memory_order::relaxed);
+				if (!child) {
+					bool leaf = level == PAGE_MAP_LEVELS - 2;
+					auto* mem = arena_alloc.allocate(leaf ? sizeof(PageLeaf) : sizeof(PageTable));
+					if (!mem) {
+						page_map_prune(page);
+						return nullptr;
 					}
-					arena_alloc.deallocate(arena, 0x1000 + Config::POW2_ARENA_SIZE);
-				}
-				else {
-					--arena->count;
-					if (arena->count == arena->max - 1) {
-						guard->push(arena);
+
+					if (leaf) {
+						child = new (mem) PageLeaf {};
 					}
-					arena->freelist.push(new (ptr) Header {});
+					else {
+						child = new (mem) PageTable {};
+					}
+					slot.store(child, memory_order::release);
+					++node->used;
+				}
+				node = child;
+			}
+
+			++node->used;
+			return static_cast<PageLeaf*>(node);
+		}
+
+		// Requires the region lock.
+		void page_map_unpin(uintptr_t page) {
+			--find_page_leaf(page)->used;
+			page_map_prune(page);
+		}
+
+		// Frees the nodes on the path to page that aren't used anymore, the root is never freed.
+		void page_map_prune(uintptr_t page) {
+			PageNode* path[PAGE_MAP_LEVELS] {&page_map};
+			size_t depth = 1;
+			for (; depth < PAGE_MAP_LEVELS; ++depth) {
+				path[depth] = static_cast<PageTable*>(path[depth - 1])->children[
+					page_map_index(page, depth - 1)].load(memory_order::relaxed);
+				if (!path[depth]) {
+					break;
 				}
 			}
-			else {
-				size_t index = SIZE_MAX;
 
-				for (size_t i = 0; i < Config::SMALL_SLABS.size(); ++i) {
-					const auto& slab_info = Config::SMALL_SLABS[i];
-					if (slab_info.first >= info->size) {
-						index = i;
-						break;
+			while (--depth > 0 && !path[depth]->used) {
+				auto* parent = static_cast<PageTable*>(path[depth - 1]);
+				parent->children[page_map_index(page, depth - 1)].store(nullptr, memory_order::relaxed);
+				--parent->used;
+				arena_alloc.deallocate(path[depth], depth == PAGE_MAP_LEVELS - 1 ? sizeof(PageLeaf) : sizeof(PageTable));
+			}
+		}
+
+		// Requires the region lock, returns false if the page map nodes couldn't be allocated.
+		bool page_map_insert(Arena* arena) {
+			auto first = arena->start >> 12;
+			auto last = (arena->start + arena->size - 1) >> 12;
+			for (auto page = first; page <= last; ++page) {
+				auto* leaf = page_map_pin(page);
+				if (!leaf) {
+					for (auto inserted = first; inserted < page; ++inserted) {
+						page_map_clear(inserted);
 					}
+					return false;
 				}
 
-				if (index == SIZE_MAX) {
-					Verifier::invalid_config("no small slabs");
-					__builtin_trap();
+				uint32_t begin = page == first ? arena->start & 0xFFF : 0;
+				uint32_t end = page == last ? ((arena->start + arena->size - 1) & 0xFFF) + 1 : 0x1000;
+				auto& entry = leaf->entries[page_map_index(page, PAGE_MAP_LEVELS - 1)];
+				entry.arena.store(arena, memory_order::relaxed);
+				entry.range.store(begin << 16 | end, memory_order::release);
+			}
+			return true;
+		}
+
+		// Requires the region lock.
+		void page_map_remove(Arena* arena) {
+			auto first = arena->start >> 12;
+			auto last = (arena->start + arena->size - 1) >> 12;
+			for (auto page = first; page <= last; ++page) {
+				page_map_clear(page);
+			}
+		}
+
+		void page_map_clear(uintptr_t page) {
+			auto& entry = find_page_leaf(page)->entries[page_map_index(page, PAGE_MAP_LEVELS - 1)];
+			entry.range.store(0, memory_order::relaxed);
+			entry.arena.store(nullptr, memory_order::relaxed);
+			page_map_unpin(page);
+		}
+
+		static constexpr ArenaClass small_arena_for(size_t index) {
+			return {
+				.kind = RegionKind::Small,
+				.index = index,
+				.block_size = Config::SMALL_SLABS[index].first,
+				.block_count = Config::SMALL_SLABS[index].second
+			};
+		}
+
+		void* alloc_block(Lock<list<Arena, &Arena::hook>>& free_arenas, ArenaClass arena_class) {
+			auto guard = free_arenas.lock();
+			Arena* arena;
+			if (!guard->is_empty()) {
+				arena = guard->front();
+			}
+			else {
+				auto* arena_mem = arena_alloc.allocate(0x1000 + arena_class.block_size * arena_class.block_count);
+				if (!arena_mem) {
+					return nullptr;
 				}
 
-				auto guard = free_small_arenas[index].lock();
-				auto* arena = info->arena;
-				if (arena->count == 1) {
-					if (arena->count != arena->max) {
-						guard->remove(arena);
-					}
-					auto block_size = Config::SMALL_SLABS[index].first;
-					auto block_count = Config::SMALL_SLABS[index].second;
-					auto total_size = block_size * block_count;
-					arena_alloc.deallocate(arena, 0x1000 + total_size);
+				arena = new (arena_mem) Arena {};
+				arena->start = reinterpret_cast<uintptr_t>(arena_mem) + 0x1000;
+				arena->size = arena_class.block_size * arena_class.block_count;
+				arena->kind = arena_class.kind;
+				arena->max = arena_class.block_count;
+				arena->index = arena_class.index;
+				arena->block_size = arena_class.block_size;
+
+				for (size_t i = 0; i < arena->max; ++i) {
+					auto* hdr = new (static_cast<char*>(arena_mem) + 0x1000 + i * arena_class.block_size) Header {};
+					arena->freelist.push(hdr);
 				}
-				else {
-					--arena->count;
-					if (arena->count == arena->max - 1) {
-						guard->push(arena);
+
+				{
+					auto regions_guard = regions->lock();
+					if (!page_map_insert(arena)) {
+						arena_alloc.deallocate(arena_mem, 0x1000 + arena->size);
+						return nullptr;
 					}
-					arena->freelist.push(new (ptr) Header {});
+					regions_guard->insert(arena);
 				}
+				guard->push(arena);
+			}
+
+			++arena->count;
+			void* mem = arena->freelist.pop();
+			if (arena->count == arena->max) {
+				guard->remove(arena);
 			}
 
-			auto guard = free_metadatas.lock();
-			auto* arena = info->metadata_arena;
+			set_used(arena, mem);
+			return mem;
+		}
+
+		void release_block(Arena* arena, void* ptr) {
+			auto& free_arenas = arena->kind == RegionKind::Small ?
+				*free_small_arenas[arena->index] :
+				*free_pow2_arenas[arena->index];
+
+			auto guard = free_arenas.lock();
 			if (arena->count == 1) {
 				if (arena->count != arena->max) {
 					guard->remove(arena);
 				}
-				arena_alloc.deallocate(arena, 0x1000);
+				{
+					auto regions_guard = regions->lock();
+					regions_guard->remove(arena);
+					page_map_remove(arena);
+				}
+				arena_alloc.deallocate(arena, 0x1000 + arena->size);
 			}
 			else {
 				--arena->count;
 				if (arena->count == arena->max - 1) {
 					guard->push(arena);
 				}
-				arena->freelist.push(info);
+				arena->freelist.push(new (ptr) Header {});
 			}
 		}
 
-	private:
-		struct Header {
-			list_hook hook;
-		};
+		static Region* find_region(rb_tree<Region, &Region::tree_hook>& tree, void* ptr) {
+			auto addr = reinterpret_cast<uintptr_t>(ptr);
+			auto* region = tree.template find_le<uintptr_t, &Region::start>(addr);
+			if (!region || addr - region->start >= region->size) {
+				return nullptr;
+			}
+			if (region->kind == RegionKind::Large) {
+				return addr == region->start ? region : nullptr;
+			}
+			if ((addr - region->start) % static_cast<Arena*>(region)->block_size) {
+				return nullptr;
+			}
+			return region;
+		}
 
-		struct Arena {
-			list_hook hook;
-			list<Header, &Header::hook> freelist;
-			size_t max {};
-			size_t count {};
-		};
+		Arena* lookup_arena(void* ptr) {
+			auto guard = regions->lock();
+			return static_cast<Arena*>(find_region(*guard, ptr));
+		}
 
-		struct MetadataPage;
+		// Frees the block holding the record of a large allocation.
+		void release_record(void* record) {
+			auto* arena = lookup_arena(record);
+			clear_used(arena, record);
+			release_block(arena, record);
+		}
 
-		struct AllocInfo {
-			union {
-				rb_tree_hook tree_hook {};
-				list_hook freelist_hook;
-			};
-			void* ptr;
-			size_t size;
-			Arena* arena;
-			MetadataPage* metadata_arena;
+		static void set_used(Arena* arena, void* ptr) {
+			auto block = (reinterpret_cast<uintptr_t>(ptr) - arena->start) / arena->block_size;
+			arena->used[block / 64].fetch_or(uint64_t {1} << (block % 64), memory_order::relaxed);
+		}
 
-			constexpr bool operator==(const AllocInfo& other) const {
-				return ptr == other.ptr;
-			}
+		// Returns false if the block wasn't in use.
+		static bool clear_used(Arena* arena, void* ptr) {
+			auto block = (reinterpret_cast<uintptr_t>(ptr) - arena->start) / arena->block_size;
+			auto bit = uint64_t {1} << (block % 64);
+			return arena->used[block / 64].fetch_and(~bit, memory_order::relaxed) & bit;
+		}
 
-			constexpr bool operator>(const AllocInfo& other) const {
-				return ptr > other.ptr;
+		static size_t size_to_small_index(size_t size) {
+			for (size_t i = 0; i < Config::SMALL_SLABS.size(); ++i) {
+				if (Config::SMALL_SLABS[i].first >= size) {
+					return i;
+				}
 			}
 
-			constexpr bool operator<(const AllocInfo& other) const {
-				return ptr < other.ptr;
-			}
-		};
+			Verifier::invalid_config("no small slabs");
+			__builtin_trap();
+		}
 
-		struct MetadataPage {
-			list_hook hook;
-			list<AllocInfo, &AllocInfo::freelist_hook> freelist;
-			size_t max {};
-			size_t count {};
-		};
+		static constexpr size_t get_thread_cache_blocks() {
+			if constexpr (requires { Config::THREAD_CACHE_BLOCKS; }) {
+				return Config::THREAD_CACHE_BLOCKS;
+			}
+			else {
+				return 32;
+			}
+		}
 
 		static constexpr size_t size_to_pow2_index(size_t size) {
 			if (size <= Config::POW2_SLABS_BEGIN) {
@@ -378,14 +665,89 @@ namespace hz {
 			return Config::POW2_SLABS_BEGIN << index;
 		}
 
-		static_assert((Config::SMALL_SLABS.size() && Config::SMALL_SLABS[0].first >= sizeof(Header)) ||
-			!Config::SMALL_SLABS.size());
+		static_assert((Config::SMALL_SLABS.size() && Config::SMALL_SLABS[0].first >= sizeof(Header) &&
+			Config::SMALL_SLABS[0].first >= sizeof(CachedBlock)) || !Config::SMALL_SLABS.size());
+
+	public:
+		// Per thread cache of small blocks. Register a thread by constructing one for it,
+		// in hosted environments usually as a thread_local so its destructor returns the
+		// cached blocks when the thread exits. Freestanding users keep it in their thread structure
+		// and destroy it (or call flush) on thread exit. Only the owning thread may use the cache,
+		// its lock is only contended while slab_allocator::scavenge returns the blocks of an idle cache.
+		// The cache must not outlive the allocator.
+		class thread_cache {
+		public:
+			explicit thread_cache(slab_allocator& owner) : owner {&owner} {
+				owner.threads->lock()->push(this);
+			}
+
+			thread_cache(const thread_cache&) = delete;
+			thread_cache& operator=(const thread_cache&) = delete;
+
+			~thread_cache() {
+				owner->threads->lock()->remove(this);
+				owner->flush_cache(*this);
+			}
+
+			// Returns all cached blocks to the shared arenas.
+			size_t flush() {
+				return owner->flush_cache(*this);
+			}
+
+		private:
+			friend slab_allocator;
+
+			slab_allocator* owner;
+			list_hook hook {};
+			CachedBlock* blocks[Config::SMALL_SLABS.size()] {};
+			size_t counts[Config::SMALL_SLABS.size()] {};
+			// only contended while scavenge takes the blocks of the cache
+			spinlock<void> busy {};
+			// set by the owner and cleared by scavenge, guarded by busy
+			bool used {};
+		};
+
+	private:
+		size_t flush_cache(thread_cache& cache) {
+			CachedBlock* blocks[Config::SMALL_SLABS.size()] {};
+			{
+				auto guard = cache.busy.lock();
+				take_cached_blocks(cache, blocks);
+			}
+			return release_cached_blocks(blocks);
+		}
+
+		// Requires the busy lock of the cache.
+		static void take_cached_blocks(thread_cache& cache, CachedBlock** blocks) {
+			for (size_t i = 0; i < Config::SMALL_SLABS.size(); ++i) {
+				blocks[i] = cache.blocks[i];
+				cache.blocks[i] = nullptr;
+				cache.counts[i] = 0;
+			}
+		}
+
+		size_t release_cached_blocks(CachedBlock** blocks) {
+			size_t released = 0;
+			for (size_t i = 0; i < Config::SMALL_SLABS.size(); ++i) {
+				auto* block = blocks[i];
+				while (block) {
+					auto* next = block->next;
+					release_block(block->arena, block);
+					block = next;
+					++released;
+				}
+			}
+			return released;
+		}
 
 		ArenaAllocator arena_alloc;
-		spinlock<rb_tree<AllocInfo, &AllocInfo::tree_hook>> allocations {};
-		spinlock<list<Arena, &Arena::hook>> free_small_arenas[Config::SMALL_SLABS.size()] {};
-		spinlock<list<Arena, &Arena::hook>> free_pow2_arenas[
+		// every lock gets its own cache line so threads using different size classes don't contend
+		cache_padded<Lock<rb_tree<Region, &Region::tree_hook>>> regions {};
+		// root of the page map, guarded by regions
+		PageTable page_map {};
+		cache_padded<Lock<list<Arena, &Arena::hook>>> free_small_arenas[Config::SMALL_SLABS.size()] {};
+		cache_padded<Lock<list<Arena, &Arena::hook>>> free_pow2_arenas[
 			popcount(Config::POW2_SLABS_END - Config::POW2_SLABS_BEGIN) + 1] {};
-		spinlock<list<MetadataPage, &MetadataPage::hook>> free_metadatas {};
+		cache_padded<Lock<list<thread_cache, &thread_cache::hook>>> threads {};
 	};
 }
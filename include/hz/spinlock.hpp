@@ -1,5 +1,9 @@
 #pragma once
+#include <stdint.h>
 #include "atomic.hpp"
+#include "backoff.hpp"
+#include "lock_stats.hpp"
+#include "optional.hpp"
 #if __STDC_HOSTED__ == 1
 #include <utility>
 #else
@@ -7,19 +11,29 @@
 #endif
 
 namespace hz {
-	template<typename T>
+	// Backoff decides how to wait while the lock is held by someone else,
+	// Stats can be set to hz::lock_stats to count contention, it is available through stats().
+	template<typename T, backoff_policy Backoff = pause_backoff, lock_stats_policy Stats = no_lock_stats>
 	class spinlock {
 	public:
 		constexpr spinlock() = default;
 
-		constexpr spinlock(T&& data) : data {.value {std::move(data)}, .lock {}} {} // NOLINT(*-explicit-constructor)
-		constexpr spinlock(const T& data) : data {.value {data}, .lock {}} {} // NOLINT(*-explicit-constructor)
+		constexpr spinlock(T&& data) : data {.value {std::move(data)}, .lock {}, .stats {}} {} // NOLINT(*-explicit-constructor)
+		constexpr spinlock(const T& data) : data {.value {data}, .lock {}, .stats {}} {} // NOLINT(*-explicit-constructor)
 
 		struct guard {
 			constexpr guard(const guard&) = delete;
 			constexpr guard& operator=(const guard&) = delete;
 
+			// Needed to return a guard inside an optional, the moved from guard doesn't unlock.
+			constexpr guard(guard&& other) noexcept : owner {other.owner} {
+				other.owner = nullptr;
+			}
+
 			inline ~guard() {
+				if (!owner) {
+					return;
+				}
 				owner->data.lock.store(false, memory_order::release);
 #ifdef __aarch64__
 				asm volatile("sev");
@@ -47,18 +61,52 @@ namespace hz {
 		};
 
 		[[nodiscard]] guard lock() {
+			Backoff backoff {};
+			uint64_t spins = 0;
+			bool contended = false;
 			while (true) {
 				if (!data.lock.exchange(true, memory_order::acquire)) {
 					break;
 				}
+				contended = true;
 				while (data.lock.load(memory_order::relaxed)) {
-#ifdef __x86_64__
-					__builtin_ia32_pause();
-#elif defined(__aarch64__)
-					asm volatile("wfe");
-#endif
+					backoff.wait();
+					++spins;
+				}
+			}
+			data.stats.record(contended, spins);
+			return guard {this};
+		}
+
+		// Acquires the lock only if it is free right now.
+		[[nodiscard]] optional<guard> try_lock() {
+			if (data.lock.load(memory_order::relaxed) || data.lock.exchange(true, memory_order::acquire)) {
+				return nullopt;
+			}
+			data.stats.record(false, 0);
+			return guard {this};
+		}
+
+		// Like lock but gives up after max_spins backoff iterations, every failed attempt takes at least one.
+		[[nodiscard]] optional<guard> try_lock_for(uint64_t max_spins) {
+			Backoff backoff {};
+			uint64_t spins = 0;
+			bool contended = false;
+			while (true) {
+				if (!data.lock.exchange(true, memory_order::acquire)) {
+					break;
 				}
+				contended = true;
+				// a failed attempt costs an iteration even if the lock looks free right after it
+				do {
+					if (spins == max_spins) {
+						return nullopt;
+					}
+					backoff.wait();
+					++spins;
+				} while (data.lock.load(memory_order::relaxed));
 			}
+			data.stats.record(contended, spins);
 			return guard {this};
 		}
 
@@ -66,17 +114,22 @@ namespace hz {
 			return data.value;
 		}
 
+		const Stats& stats() const {
+			return data.stats;
+		}
+
 	private:
 		struct Data {
 			T value {};
 			atomic<bool> lock {};
+			[[no_unique_address]] Stats stats {};
 		};
 
 		Data data {};
 	};
 
-	template<>
-	class spinlock<void> {
+	template<backoff_policy Backoff, lock_stats_policy Stats>
+	class spinlock<void, Backoff, Stats> {
 	public:
 		constexpr spinlock() = default;
 
@@ -84,7 +137,15 @@ namespace hz {
 			constexpr guard(const guard&) = delete;
 			constexpr guard& operator=(const guard&) = delete;
 
+			// Needed to return a guard inside an optional, the moved from guard doesn't unlock.
+			constexpr guard(guard&& other) noexcept : owner {other.owner} {
+				other.owner = nullptr;
+			}
+
 			inline ~guard() {
+				if (!owner) {
+					return;
+				}
 				owner->_lock.store(false, memory_order::release);
 #ifdef __aarch64__
 				asm volatile("sev");
@@ -100,22 +161,61 @@ namespace hz {
 		};
 
 		[[nodiscard]] guard lock() {
+			Backoff backoff {};
+			uint64_t spins = 0;
+			bool contended = false;
 			while (true) {
 				if (!_lock.exchange(true, memory_order::acquire)) {
 					break;
 				}
+				contended = true;
 				while (_lock.load(memory_order::relaxed)) {
-#ifdef __x86_64__
-					__builtin_ia32_pause();
-#elif defined(__aarch64__)
-					asm volatile("wfe");
-#endif
+					backoff.wait();
+					++spins;
+				}
+			}
+			_stats.record(contended, spins);
+			return guard {this};
+		}
+
+		// Acquires the lock only if it is free right now.
+		[[nodiscard]] optional<guard> try_lock() {
+			if (_lock.load(memory_order::relaxed) || _lock.exchange(true, memory_order::acquire)) {
+				return nullopt;
+			}
+			_stats.record(false, 0);
+			return guard {this};
+		}
+
+		// Like lock but gives up after max_spins backoff iterations, every failed attempt takes at least one.
+		[[nodiscard]] optional<guard> try_lock_for(uint64_t max_spins) {
+			Backoff backoff {};
+			uint64_t spins = 0;
+			bool contended = false;
+			while (true) {
+				if (!_lock.exchange(true, memory_order::acquire)) {
+					break;
 				}
+				contended = true;
+				// a failed attempt costs an iteration even if the lock looks free right after it
+				do {
+					if (spins == max_spins) {
+						return nullopt;
+					}
+					backoff.wait();
+					++spins;
+				} while (_lock.load(memory_order::relaxed));
 			}
+			_stats.record(contended, spins);
 			return guard {this};
 		}
 
+		const Stats& stats() const {
+			return _stats;
+		}
+
 	private:
-		atomic<bool> _lock;
+		atomic<bool> _lock {};
+		[[no_unique_address]] Stats _stats {};
 	};
 }
@@ -0,0 +1,213 @@
+#pragma once
+#include <stddef.h>
+#include "allocator.hpp"
+#include "atomic.hpp"
+#include "bit.hpp"
+#include "cache_padded.hpp"
+#include "optional.hpp"
+#if __STDC_HOSTED__ == 1
+#include <new>
+#include <utility>
+#else
+#include "new.hpp"
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	namespace __detail {
+		// Ring shared between exactly one producer and one consumer thread. Indices only ever increase
+		// and are masked with the power of two capacity. Each side keeps a cached copy of the other side's
+		// index on its own cache line and only reloads it when the ring looks full or empty.
+		// Derived provides get_slots() and get_capacity().
+		template<typename Derived, typename T>
+		class spsc_ring_base {
+		public:
+			spsc_ring_base() = default;
+			spsc_ring_base(const spsc_ring_base&) = delete;
+			spsc_ring_base& operator=(const spsc_ring_base&) = delete;
+
+			// Producer only.
+			bool try_push(T value) {
+				auto tail = producer->tail.load(memory_order::relaxed);
+				if (tail - producer->cached_head == capacity() && !refresh_head(tail, 1)) {
+					return false;
+				}
+
+				new (&slots()[tail & (capacity() - 1)]) T {std::move(value)};
+				producer->tail.store(tail + 1, memory_order::release);
+				return true;
+			}
+
+			// Producer only, moves up to count values from values into the ring and returns how many were pushed.
+			size_t push_batch(T* values, size_t count) {
+				auto tail = producer->tail.load(memory_order::relaxed);
+				size_t free = capacity() - (tail - producer->cached_head);
+				if (free < count) {
+					refresh_head(tail, count);
+					free = capacity() - (tail - producer->cached_head);
+				}
+
+				size_t pushed = count < free ? count : free;
+				auto* ring = slots();
+				for (size_t i = 0; i < pushed; ++i) {
+					new (&ring[(tail + i) & (capacity() - 1)]) T {std::move(values[i])};
+				}
+				producer->tail.store(tail + pushed, memory_order::release);
+				return pushed;
+			}
+
+			// Consumer only.
+			optional<T> try_pop() {
+				auto head = consumer->head.load(memory_order::relaxed);
+				if (head == consumer->cached_tail && !refresh_tail(head, 1)) {
+					return nullopt;
+				}
+
+				auto& slot = slots()[head & (capacity() - 1)];
+				optional<T> value {std::move(slot)};
+				slot.~T();
+				consumer->head.store(head + 1, memory_order::release);
+				return value;
+			}
+
+			// Consumer only, moves up to count values into out and returns how many were popped.
+			size_t pop_batch(T* out, size_t count) {
+				auto head = consumer->head.load(memory_order::relaxed);
+				size_t available = consumer->cached_tail - head;
+				if (available < count) {
+					refresh_tail(head, count);
+					available = consumer->cached_tail - head;
+				}
+
+				size_t popped = count < available ? count : available;
+				auto* ring = slots();
+				for (size_t i = 0; i < popped; ++i) {
+					auto& slot = ring[(head + i) & (capacity() - 1)];
+					out[i] = std::move(slot);
+					slot.~T();
+				}
+				consumer->head.store(head + popped, memory_order::release);
+				return popped;
+			}
+
+			// Only exact if neither side is running concurrently.
+			[[nodiscard]] size_t size_approx() const {
+				auto head = consumer->head.load(memory_order::relaxed);
+				return producer->tail.load(memory_order::relaxed) - head;
+			}
+
+			[[nodiscard]] size_t get_capacity() const {
+				return static_cast<const Derived*>(this)->capacity_impl();
+			}
+
+		protected:
+			void destroy_all() {
+				auto head = consumer->head.load(memory_order::relaxed);
+				auto tail = producer->tail.load(memory_order::relaxed);
+				for (; head != tail; ++head) {
+					slots()[head & (capacity() - 1)].~T();
+				}
+				consumer->head.store(head, memory_order::relaxed);
+			}
+
+		private:
+			T* slots() {
+				return static_cast<Derived*>(this)->slots_impl();
+			}
+
+			size_t capacity() const {
+				return static_cast<const Derived*>(this)->capacity_impl();
+			}
+
+			bool refresh_head(size_t tail, size_t needed) {
+				producer->cached_head = consumer->head.load(memory_order::acquire);
+				return capacity() - (tail - producer->cached_head) >= needed;
+			}
+
+			bool refresh_tail(size_t head, size_t needed) {
+				consumer->cached_tail = producer->tail.load(memory_order::acquire);
+				return consumer->cached_tail - head >= needed;
+			}
+
+			struct Producer {
+				atomic<size_t> tail {};
+				size_t cached_head {};
+			};
+
+			struct Consumer {
+				atomic<size_t> head {};
+				size_t cached_tail {};
+			};
+
+			cache_padded<Producer> producer {};
+			cache_padded<Consumer> consumer {};
+		};
+	}
+
+	// Single producer single consumer ring with a fixed power of two capacity N.
+	template<typename T, size_t N>
+	class spsc_ring : public __detail::spsc_ring_base<spsc_ring<T, N>, T> {
+	public:
+		static_assert(N && !(N & (N - 1)), "the capacity must be a power of two");
+
+		constexpr spsc_ring() = default;
+
+		~spsc_ring() {
+			this->destroy_all();
+		}
+
+	private:
+		friend __detail::spsc_ring_base<spsc_ring<T, N>, T>;
+
+		T* slots_impl() {
+			return std::launder(reinterpret_cast<T*>(storage));
+		}
+
+		static constexpr size_t capacity_impl() {
+			return N;
+		}
+
+		alignas(T) char storage[N * sizeof(T)];
+	};
+
+	// Single producer single consumer ring with a capacity chosen at runtime,
+	// rounded up to a power of two. If the allocation fails the capacity is zero.
+	template<typename T, Allocator Allocator>
+	class dynamic_spsc_ring : public __detail::spsc_ring_base<dynamic_spsc_ring<T, Allocator>, T> {
+	public:
+		dynamic_spsc_ring(size_t capacity, Allocator alloc) : alloc {std::move(alloc)} {
+			capacity = capacity <= 1 ? 1 : bit_ceil(capacity);
+			storage = static_cast<T*>(this->alloc.allocate(capacity * sizeof(T)));
+			cap = storage ? capacity : 0;
+		}
+
+		~dynamic_spsc_ring() {
+			if (!storage) {
+				return;
+			}
+
+			this->destroy_all();
+			if constexpr (SizedAllocator<Allocator>) {
+				alloc.deallocate(storage, cap * sizeof(T));
+			}
+			else {
+				alloc.deallocate(storage);
+			}
+		}
+
+	private:
+		friend __detail::spsc_ring_base<dynamic_spsc_ring<T, Allocator>, T>;
+
+		T* slots_impl() {
+			return storage;
+		}
+
+		size_t capacity_impl() const {
+			return cap;
+		}
+
+		T* storage;
+		size_t cap;
+		Allocator alloc;
+	};
+}
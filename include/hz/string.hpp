@@ -322,7 +322,18 @@ namespace hz {
 			if (new_cap < cap + amount) {
 				new_cap = cap + amount;
 			}
-			auto* new_data = static_cast<T*>(alloc.allocate((new_cap + 1) * sizeof(T)));
+			T* new_data;
+			if constexpr (AtLeastAllocator<Allocator>) {
+				auto result = alloc.allocate_at_least((new_cap + 1) * sizeof(T));
+				new_data = static_cast<T*>(result.ptr);
+				// a failed allocation reports a count of 0, which must not become the capacity
+				if (new_data) {
+					new_cap = result.count / sizeof(T) - 1;
+				}
+			}
+			else {
+				new_data = static_cast<T*>(alloc.allocate((new_cap + 1) * sizeof(T)));
+			}
 
 			for (size_t i = 0; i < _size; ++i) {
 				new_data[i] = _data[i];
@@ -0,0 +1,275 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <thread>
+#include <utility>
+#include "allocator.hpp"
+#include "atomic.hpp"
+#include "cache_padded.hpp"
+#include "cpu_relax.hpp"
+#include "mpmc_queue.hpp"
+#include "work_stealing_deque.hpp"
+
+namespace hz {
+	// Hosted only. Fixed set of worker threads, each owning a work stealing deque.
+	// Work submitted from outside goes through a shared injection queue, workers take their own
+	// newest tasks first and steal the oldest ones from others when they run dry.
+	// Idle workers spin briefly and then sleep through atomic::wait.
+	// Workers and deques are allocated through Allocator.
+	template<Allocator Allocator>
+	class thread_pool {
+	public:
+		thread_pool(size_t thread_count, Allocator alloc) : injected {INJECT_CAPACITY, alloc}, alloc {std::move(alloc)} {
+			if (!thread_count) {
+				return;
+			}
+
+			worker_storage = this->alloc.allocate(workers_size(thread_count));
+			if (!worker_storage) {
+				return;
+			}
+
+			auto addr = reinterpret_cast<uintptr_t>(worker_storage);
+			workers = reinterpret_cast<Worker*>((addr + alignof(Worker) - 1) & ~(alignof(Worker) - 1));
+			for (size_t i = 0; i < thread_count; ++i) {
+				new (&workers[i]) Worker {this, i, this->alloc};
+			}
+			worker_count = thread_count;
+			for (size_t i = 0; i < thread_count; ++i) {
+				workers[i].thread = std::thread {[this, i] {
+					run_worker(workers[i]);
+				}};
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool() {
+			if (!worker_storage) {
+				return;
+			}
+
+			stopping.store(true, memory_order::seq_cst);
+			work_epoch->fetch_add(1, memory_order::seq_cst);
+			work_epoch->notify_all();
+			for (size_t i = 0; i < worker_count; ++i) {
+				workers[i].thread.join();
+				workers[i].~Worker();
+			}
+
+			if constexpr (SizedAllocator<Allocator>) {
+				alloc.deallocate(worker_storage, workers_size(worker_count));
+			}
+			else {
+				alloc.deallocate(worker_storage);
+			}
+		}
+
+		[[nodiscard]] size_t get_thread_count() const {
+			return worker_count;
+		}
+
+		// Calls fn(i) for every i in [begin, end), split into chunks of grain indices that are
+		// executed in parallel, and returns once all calls finished. The participating threads claim
+		// the chunks one at a time from a shared counter, so uneven chunks are balanced at the requested
+		// grain without any storage per chunk. Called from a worker, the worker executes tasks while
+		// waiting, otherwise the calling thread sleeps. Runs on the calling thread if the pool has no workers.
+		template<typename F>
+		void parallel_for(size_t begin, size_t end, size_t grain, F fn) {
+			if (begin >= end) {
+				return;
+			}
+			if (!grain) {
+				grain = 1;
+			}
+
+			size_t chunks = (end - begin + grain - 1) / grain;
+			if (!worker_count || chunks == 1) {
+				for (size_t i = begin; i < end; ++i) {
+					fn(i);
+				}
+				return;
+			}
+
+			Task task {
+				.invoke = [](void* ptr, size_t first, size_t last) {
+					auto& f = *static_cast<F*>(ptr);
+					for (size_t i = first; i < last; ++i) {
+						f(i);
+					}
+				},
+				.fn = &fn,
+				.begin = begin,
+				.end = end,
+				.grain = grain,
+				.chunks = chunks,
+				.next {},
+				.helpers {},
+				.refs {1}
+			};
+
+			auto* self = current_worker;
+			if (self && self->pool == this) {
+				run_task(*self, &task);
+				while (task.refs.load(memory_order::acquire)) {
+					if (auto* other = find_task(*self)) {
+						run_task(*self, other);
+					}
+					else {
+						cpu_relax();
+					}
+				}
+			}
+			else {
+				while (!injected.try_push(&task)) {
+					std::this_thread::yield();
+				}
+				wake();
+
+				while (true) {
+					auto completed = completions->load(memory_order::acquire);
+					if (!task.refs.load(memory_order::acquire)) {
+						break;
+					}
+					completions->wait(completed, memory_order::acquire);
+				}
+			}
+		}
+
+	private:
+		static constexpr size_t INJECT_CAPACITY = 64;
+		static constexpr size_t DEQUE_CAPACITY = 64;
+		static constexpr size_t IDLE_SPINS = 64;
+
+		// A parallel_for call, every pointer to it in a queue is a reference that helps claiming chunks.
+		struct Task {
+			void (*invoke)(void* fn, size_t first, size_t last);
+			void* fn;
+			size_t begin;
+			size_t end;
+			size_t grain;
+			size_t chunks;
+			// next chunk to claim, runs past chunks once all are claimed
+			atomic<size_t> next;
+			// references handed to other workers so far
+			atomic<size_t> helpers;
+			// references that haven't finished running
+			atomic<size_t> refs;
+		};
+
+		struct Worker {
+			Worker(thread_pool* pool, size_t index, Allocator alloc)
+				: deque {DEQUE_CAPACITY, std::move(alloc)}, pool {pool}, index {index} {}
+
+			work_stealing_deque<Task*, Allocator> deque;
+			thread_pool* pool;
+			size_t index;
+			std::thread thread;
+		};
+
+		static constexpr size_t workers_size(size_t count) {
+			return count * sizeof(Worker) + alignof(Worker) - 1;
+		}
+
+		Task* find_task(Worker& self) {
+			if (auto task = self.deque.pop()) {
+				return *task;
+			}
+			if (auto task = injected.try_pop()) {
+				return *task;
+			}
+			for (size_t i = 1; i < worker_count; ++i) {
+				auto& victim = workers[(self.index + i) % worker_count];
+				if (auto task = victim.deque.steal()) {
+					return *task;
+				}
+			}
+			return nullptr;
+		}
+
+		void run_task(Worker& self, Task* task) {
+			// while chunks are left every reference recruits one more worker, up to one per worker
+			if (task->next.load(memory_order::relaxed) + 1 < task->chunks &&
+				task->helpers.fetch_add(1, memory_order::relaxed) + 1 < worker_count) {
+				task->refs.fetch_add(1, memory_order::relaxed);
+				if (self.deque.push(task)) {
+					wake();
+				}
+				else {
+					task->refs.fetch_sub(1, memory_order::relaxed);
+				}
+			}
+
+			while (true) {
+				auto chunk = task->next.fetch_add(1, memory_order::relaxed);
+				if (chunk >= task->chunks) {
+					break;
+				}
+				auto begin = task->begin + chunk * task->grain;
+				auto end = task->end - begin > task->grain ? begin + task->grain : task->end;
+				task->invoke(task->fn, begin, end);
+			}
+
+			// the task may be gone once refs reaches zero, only the pool is touched afterwards
+			if (task->refs.fetch_sub(1, memory_order::acq_rel) == 1) {
+				completions->fetch_add(1, memory_order::release);
+				completions->notify_all();
+			}
+		}
+
+		void run_worker(Worker& self) {
+			current_worker = &self;
+			while (true) {
+				Task* task = nullptr;
+				for (size_t i = 0; !task && i < IDLE_SPINS; ++i) {
+					task = find_task(self);
+					if (!task) {
+						cpu_relax();
+					}
+				}
+
+				if (!task) {
+					sleepers->fetch_add(1, memory_order::seq_cst);
+					// pairs with the fence in wake, either the task is found or the waker sees the sleeper
+					atomic_thread_fence(memory_order::seq_cst);
+					auto epoch = work_epoch->load(memory_order::acquire);
+					if (stopping.load(memory_order::acquire)) {
+						sleepers->fetch_sub(1, memory_order::relaxed);
+						return;
+					}
+					task = find_task(self);
+					if (!task) {
+						work_epoch->wait(epoch, memory_order::acquire);
+						sleepers->fetch_sub(1, memory_order::relaxed);
+						continue;
+					}
+					sleepers->fetch_sub(1, memory_order::relaxed);
+				}
+
+				run_task(self, task);
+			}
+		}
+
+		void wake() {
+			atomic_thread_fence(memory_order::seq_cst);
+			if (sleepers->load(memory_order::relaxed)) {
+				work_epoch->fetch_add(1, memory_order::release);
+				work_epoch->notify_one();
+			}
+		}
+
+		static inline thread_local Worker* current_worker = nullptr;
+
+		Worker* workers {};
+		size_t worker_count {};
+		void* worker_storage {};
+		mpmc_queue<Task*, Allocator> injected;
+		cache_padded<atomic<uint32_t>> work_epoch {};
+		cache_padded<atomic<uint32_t>> sleepers {};
+		cache_padded<atomic<uint32_t>> completions {};
+		atomic<bool> stopping {};
+		Allocator alloc;
+	};
+}
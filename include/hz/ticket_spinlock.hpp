@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include "atomic.hpp"
+#if __STDC_HOSTED__ == 1
+#include <utility>
+#else
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Fair spinlock handing out the lock in the order lock was called.
+	// Waiters back off proportionally to their distance from the current owner.
+	template<typename T>
+	class ticket_spinlock {
+	public:
+		constexpr ticket_spinlock() = default;
+
+		constexpr ticket_spinlock(T&& data) : value {std::move(data)} {} // NOLINT(*-explicit-constructor)
+		constexpr ticket_spinlock(const T& data) : value {data} {} // NOLINT(*-explicit-constructor)
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				owner->serving.store(owner->serving.load(memory_order::relaxed) + 1, memory_order::release);
+			}
+
+			operator T&() { // NOLINT(*-explicit-constructor)
+				return owner->value;
+			}
+
+			T& operator*() {
+				return owner->value;
+			}
+
+			T* operator->() {
+				return &owner->value;
+			}
+
+		private:
+			friend ticket_spinlock;
+
+			constexpr explicit guard(ticket_spinlock* owner) : owner {owner} {}
+
+			ticket_spinlock* owner;
+		};
+
+		[[nodiscard]] guard lock() {
+			auto ticket = next.fetch_add(1, memory_order::relaxed);
+			while (true) {
+				auto current = serving.load(memory_order::acquire);
+				if (current == ticket) {
+					break;
+				}
+				for (uint32_t i = ticket - current; i > 0; --i) {
+					cpu_relax();
+				}
+			}
+			return guard {this};
+		}
+
+		T& get_unsafe() {
+			return value;
+		}
+
+	private:
+		T value {};
+		atomic<uint32_t> next {};
+		atomic<uint32_t> serving {};
+	};
+
+	template<>
+	class ticket_spinlock<void> {
+	public:
+		constexpr ticket_spinlock() = default;
+
+		struct guard {
+			constexpr guard(const guard&) = delete;
+			constexpr guard& operator=(const guard&) = delete;
+
+			inline ~guard() {
+				owner->serving.store(owner->serving.load(memory_order::relaxed) + 1, memory_order::release);
+			}
+
+		private:
+			friend ticket_spinlock;
+
+			constexpr explicit guard(ticket_spinlock* owner) : owner {owner} {}
+
+			ticket_spinlock* owner;
+		};
+
+		[[nodiscard]] guard lock() {
+			auto ticket = next.fetch_add(1, memory_order::relaxed);
+			while (true) {
+				auto current = serving.load(memory_order::acquire);
+				if (current == ticket) {
+					break;
+				}
+				for (uint32_t i = ticket - current; i > 0; --i) {
+					cpu_relax();
+				}
+			}
+			return guard {this};
+		}
+
+	private:
+		atomic<uint32_t> next {};
+		atomic<uint32_t> serving {};
+	};
+}
@@ -0,0 +1,329 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.hpp"
+#include "bit.hpp"
+
+namespace hz {
+	struct default_tlsf_config {
+		// log2 of the number of second level lists per first level class
+		static constexpr size_t SL_INDEX_COUNT_LOG2 = 5;
+		// blocks must be smaller than 1 << FL_INDEX_MAX
+		static constexpr size_t FL_INDEX_MAX = 32;
+	};
+
+	template<typename T>
+	concept tlsf_verifier = requires(T) {
+		T::double_free_or_corruption();
+	};
+
+	struct tlsf_trap_verifier {
+		static void double_free_or_corruption() {
+			__builtin_trap();
+		}
+	};
+
+	// Two level segregated fit allocator working on a caller provided pool.
+	// Both alloc and free run in constant time, there are no loops depending on the
+	// amount or the layout of the allocations. The allocator itself is not thread safe.
+	template<typename Config = default_tlsf_config, tlsf_verifier Verifier = tlsf_trap_verifier>
+	class tlsf_allocator {
+	public:
+		tlsf_allocator(void* pool, size_t size) {
+			auto start = align_up(reinterpret_cast<uintptr_t>(pool));
+			auto end = (reinterpret_cast<uintptr_t>(pool) + size) & ~(ALIGN - 1);
+			if (end <= start || end - start < 2 * HEADER_SIZE + MIN_BLOCK_SIZE) {
+				return;
+			}
+
+			size_t block_size = end - start - 2 * HEADER_SIZE;
+			if (block_size > MAX_BLOCK_SIZE) {
+				block_size = MAX_BLOCK_SIZE;
+			}
+
+			auto* block = reinterpret_cast<Block*>(start);
+			block->prev_phys = nullptr;
+			block->size = block_size;
+			set_free(block, true);
+
+			auto* sentinel = next_phys(block);
+			sentinel->prev_phys = block;
+			sentinel->size = 0;
+			set_prev_free(sentinel, true);
+
+			insert_free_block(block);
+		}
+
+		tlsf_allocator(const tlsf_allocator&) = delete;
+		tlsf_allocator& operator=(const tlsf_allocator&) = delete;
+
+		void* alloc(size_t size) {
+			if (!size) {
+				size = 1;
+			}
+			if (size > MAX_BLOCK_SIZE) {
+				return nullptr;
+			}
+
+			size = size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : align_up(size);
+
+			auto search_size = size;
+			if (search_size >= SMALL_BLOCK_SIZE) {
+				search_size += (size_t {1} << (bit_width(search_size) - 1 - Config::SL_INDEX_COUNT_LOG2)) - 1;
+				if (search_size > MAX_BLOCK_SIZE) {
+					return nullptr;
+				}
+			}
+
+			auto [fl, sl] = mapping(search_size);
+			auto* block = find_suitable_block(fl, sl);
+			if (!block) {
+				return nullptr;
+			}
+			remove_free_block(block, fl, sl);
+
+			auto block_size = get_size(block);
+			if (block_size - size >= HEADER_SIZE + MIN_BLOCK_SIZE) {
+				auto* remaining = reinterpret_cast<Block*>(reinterpret_cast<char*>(block) + HEADER_SIZE + size);
+				remaining->prev_phys = block;
+				remaining->size = block_size - size - HEADER_SIZE;
+				set_free(remaining, true);
+
+				next_phys(remaining)->prev_phys = remaining;
+
+				block->size = size | (block->size & PREV_FREE_BIT);
+				insert_free_block(remaining);
+			}
+			else {
+				set_prev_free(next_phys(block), false);
+			}
+
+			set_free(block, false);
+			return to_ptr(block);
+		}
+
+		void free(void* ptr) {
+			if (!ptr) {
+				return;
+			}
+
+			auto* block = from_ptr(ptr);
+			if (is_free(block)) {
+				Verifier::double_free_or_corruption();
+				return;
+			}
+
+			set_free(block, true);
+
+			if (is_prev_free(block)) {
+				auto* prev = block->prev_phys;
+				remove_free_block(prev);
+				prev->size += HEADER_SIZE + get_size(block);
+				block = prev;
+			}
+
+			auto* next = next_phys(block);
+			if (is_free(next)) {
+				remove_free_block(next);
+				block->size += HEADER_SIZE + get_size(next);
+				next = next_phys(block);
+			}
+
+			next->prev_phys = block;
+			set_prev_free(next, true);
+			insert_free_block(block);
+		}
+
+		// Like alloc but also returns the usable size of the block.
+		allocation_result alloc_at_least(size_t size) {
+			auto* ptr = alloc(size);
+			return {ptr, ptr ? get_usable_size(ptr) : 0};
+		}
+
+		// Returns the usable size of the block backing ptr, which may be larger than the requested size.
+		size_t get_usable_size(void* ptr) {
+			return get_size(from_ptr(ptr));
+		}
+
+		// Allocator adapters referencing this allocator, usable with containers.
+		struct unsized_ref {
+			void* allocate(size_t size) {
+				return owner->alloc(size);
+			}
+
+			allocation_result allocate_at_least(size_t size) {
+				return owner->alloc_at_least(size);
+			}
+
+			void deallocate(void* ptr) {
+				owner->free(ptr);
+			}
+
+			tlsf_allocator* owner;
+		};
+
+		struct sized_ref {
+			void* allocate(size_t size) {
+				return owner->alloc(size);
+			}
+
+			allocation_result allocate_at_least(size_t size) {
+				return owner->alloc_at_least(size);
+			}
+
+			void deallocate(void* ptr, size_t) {
+				owner->free(ptr);
+			}
+
+			tlsf_allocator* owner;
+		};
+
+		constexpr unsized_ref as_unsized() {
+			return {this};
+		}
+
+		constexpr sized_ref as_sized() {
+			return {this};
+		}
+
+	private:
+		struct Block {
+			// only valid if the previous physical block is free
+			Block* prev_phys;
+			// payload size, the low bits are used as flags
+			size_t size;
+			// only valid if this block is free
+			Block* next_free;
+			Block* prev_free;
+		};
+
+		static constexpr size_t HEADER_SIZE = 2 * sizeof(void*);
+		static constexpr size_t ALIGN = HEADER_SIZE;
+		static constexpr size_t MIN_BLOCK_SIZE = sizeof(Block) - HEADER_SIZE;
+
+		static constexpr size_t FREE_BIT = 1 << 0;
+		static constexpr size_t PREV_FREE_BIT = 1 << 1;
+
+		static constexpr size_t SL_INDEX_COUNT = size_t {1} << Config::SL_INDEX_COUNT_LOG2;
+		static constexpr size_t FL_INDEX_SHIFT = Config::SL_INDEX_COUNT_LOG2 + (bit_width(ALIGN) - 1);
+		static constexpr size_t FL_INDEX_COUNT = Config::FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+		static constexpr size_t SMALL_BLOCK_SIZE = size_t {1} << FL_INDEX_SHIFT;
+		static constexpr size_t MAX_BLOCK_SIZE = ((size_t {1} << Config::FL_INDEX_MAX) - 1) & ~(ALIGN - 1);
+
+		static_assert(SL_INDEX_COUNT <= 32, "second level bitmaps are 32 bits wide");
+		static_assert(FL_INDEX_COUNT <= 32, "the first level bitmap is 32 bits wide");
+		static_assert(Config::FL_INDEX_MAX < sizeof(size_t) * 8);
+
+		static constexpr size_t align_up(size_t value) {
+			return (value + ALIGN - 1) & ~(ALIGN - 1);
+		}
+
+		static constexpr size_t get_size(const Block* block) {
+			return block->size & ~(FREE_BIT | PREV_FREE_BIT);
+		}
+
+		static constexpr bool is_free(const Block* block) {
+			return block->size & FREE_BIT;
+		}
+
+		static constexpr bool is_prev_free(const Block* block) {
+			return block->size & PREV_FREE_BIT;
+		}
+
+		static constexpr void set_free(Block* block, bool free) {
+			block->size = free ? (block->size | FREE_BIT) : (block->size & ~FREE_BIT);
+		}
+
+		static constexpr void set_prev_free(Block* block, bool free) {
+			block->size = free ? (block->size | PREV_FREE_BIT) : (block->size & ~PREV_FREE_BIT);
+		}
+
+		static Block* next_phys(Block* block) {
+			return reinterpret_cast<Block*>(reinterpret_cast<char*>(block) + HEADER_SIZE + get_size(block));
+		}
+
+		static void* to_ptr(Block* block) {
+			return reinterpret_cast<char*>(block) + HEADER_SIZE;
+		}
+
+		static Block* from_ptr(void* ptr) {
+			return reinterpret_cast<Block*>(static_cast<char*>(ptr) - HEADER_SIZE);
+		}
+
+		struct Index {
+			size_t fl;
+			size_t sl;
+		};
+
+		static constexpr Index mapping(size_t size) {
+			if (size < SMALL_BLOCK_SIZE) {
+				return {0, size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT)};
+			}
+
+			size_t fl = bit_width(size) - 1;
+			size_t sl = (size >> (fl - Config::SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+			return {fl - (FL_INDEX_SHIFT - 1), sl};
+		}
+
+		Block* find_suitable_block(size_t& fl, size_t& sl) {
+			uint32_t sl_map = sl_bitmap[fl] & (~uint32_t {0} << sl);
+			if (!sl_map) {
+				if (fl + 1 >= FL_INDEX_COUNT) {
+					return nullptr;
+				}
+				uint32_t fl_map = fl_bitmap & (~uint32_t {0} << (fl + 1));
+				if (!fl_map) {
+					return nullptr;
+				}
+
+				fl = countr_zero(fl_map);
+				sl_map = sl_bitmap[fl];
+			}
+
+			sl = countr_zero(sl_map);
+			return free_lists[fl][sl];
+		}
+
+		void insert_free_block(Block* block) {
+			auto [fl, sl] = mapping(get_size(block));
+			auto* head = free_lists[fl][sl];
+			block->next_free = head;
+			block->prev_free = nullptr;
+			if (head) {
+				head->prev_free = block;
+			}
+			free_lists[fl][sl] = block;
+			fl_bitmap |= uint32_t {1} << fl;
+			sl_bitmap[fl] |= uint32_t {1} << sl;
+		}
+
+		void remove_free_block(Block* block) {
+			auto [fl, sl] = mapping(get_size(block));
+			remove_free_block(block, fl, sl);
+		}
+
+		void remove_free_block(Block* block, size_t fl, size_t sl) {
+			auto* prev = block->prev_free;
+			auto* next = block->next_free;
+			if (next) {
+				next->prev_free = prev;
+			}
+			if (prev) {
+				prev->next_free = next;
+			}
+			else {
+				free_lists[fl][sl] = next;
+				if (!next) {
+					sl_bitmap[fl] &= ~(uint32_t {1} << sl);
+					if (!sl_bitmap[fl]) {
+						fl_bitmap &= ~(uint32_t {1} << fl);
+					}
+				}
+			}
+		}
+
+		uint32_t fl_bitmap {};
+		uint32_t sl_bitmap[FL_INDEX_COUNT] {};
+		Block* free_lists[FL_INDEX_COUNT][SL_INDEX_COUNT] {};
+	};
+}
@@ -244,7 +244,17 @@ namespace hz {
 			if (new_cap < cap + amount) {
 				new_cap = cap + amount;
 			}
-			auto* new_data = static_cast<T*>(alloc.allocate(new_cap * sizeof(T)));
+			T* new_data;
+			if constexpr (AtLeastAllocator<Allocator>) {
+				auto result = alloc.allocate_at_least(new_cap * sizeof(T));
+				new_data = static_cast<T*>(result.ptr);
+				if (new_data) {
+					new_cap = result.count / sizeof(T);
+				}
+			}
+			else {
+				new_data = static_cast<T*>(alloc.allocate(new_cap * sizeof(T)));
+			}
 
 			for (size_t i = 0; i < _size; ++i) {
 				new (&new_data[i]) T {std::move(_data[i])};
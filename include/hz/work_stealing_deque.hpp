@@ -0,0 +1,169 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.hpp"
+#include "atomic.hpp"
+#include "bit.hpp"
+#include "cache_padded.hpp"
+#include "optional.hpp"
+#include "type_traits.hpp"
+#if __STDC_HOSTED__ == 1
+#include <new>
+#include <utility>
+#else
+#include "new.hpp"
+#include "utility.hpp"
+#endif
+
+namespace hz {
+	// Chase-Lev work stealing deque (in the formulation of Le et al. for weak memory models).
+	// The owner pushes and pops at the bottom without contention, other threads steal from the top.
+	// Values are read racily by thieves so they are stored as atomics and must be trivially copyable.
+	// The buffer doubles when full, retired buffers may still be read by thieves and are only
+	// freed when the deque is destroyed.
+	template<typename T, Allocator Allocator> requires is_trivially_copyable_v<T>
+	class work_stealing_deque {
+	public:
+		work_stealing_deque(size_t capacity, Allocator alloc) : alloc {std::move(alloc)} {
+			array.store(allocate_buffer(capacity <= 1 ? 1 : bit_ceil(capacity)), memory_order::relaxed);
+		}
+
+		work_stealing_deque(const work_stealing_deque&) = delete;
+		work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+		~work_stealing_deque() {
+			auto* buffer = array.load(memory_order::relaxed);
+			while (buffer) {
+				auto* retired = buffer->retired;
+				free_buffer(buffer);
+				buffer = retired;
+			}
+		}
+
+		// Owner only. Returns false if the buffer is full and can't be grown.
+		bool push(T value) {
+			auto b = bottom->load(memory_order::relaxed);
+			auto t = top->load(memory_order::acquire);
+			auto* buffer = array.load(memory_order::relaxed);
+			if (!buffer || b - t > static_cast<ptrdiff_t>(buffer->mask)) {
+				buffer = grow(buffer, t, b);
+				if (!buffer) {
+					return false;
+				}
+			}
+
+			buffer->slot(b).store(value, memory_order::relaxed);
+			bottom->store(b + 1, memory_order::release);
+			return true;
+		}
+
+		// Owner only, returns the most recently pushed value.
+		optional<T> pop() {
+			auto b = bottom->load(memory_order::relaxed) - 1;
+			auto* buffer = array.load(memory_order::relaxed);
+			bottom->store(b, memory_order::relaxed);
+			// the owner's claim on the bottom slot must be ordered before reading top,
+			// pairs with the fence in steal
+			atomic_thread_fence(memory_order::seq_cst);
+			auto t = top->load(memory_order::relaxed);
+			if (t > b) {
+				bottom->store(b + 1, memory_order::relaxed);
+				return nullopt;
+			}
+
+			optional<T> value {buffer->slot(b).load(memory_order::relaxed)};
+			if (t == b) {
+				// the last value, race thieves for it
+				if (!top->compare_exchange_strong(t, t + 1, memory_order::seq_cst, memory_order::relaxed)) {
+					value = nullopt;
+				}
+				bottom->store(b + 1, memory_order::relaxed);
+			}
+			return value;
+		}
+
+		// Safe to call from any thread, returns the least recently pushed value.
+		// Fails if the deque is empty or if another thread won the race for the top value.
+		optional<T> steal() {
+			auto t = top->load(memory_order::acquire);
+			atomic_thread_fence(memory_order::seq_cst);
+			auto b = bottom->load(memory_order::acquire);
+			if (t >= b) {
+				return nullopt;
+			}
+
+			auto* buffer = array.load(memory_order::acquire);
+			T value = buffer->slot(t).load(memory_order::relaxed);
+			if (!top->compare_exchange_strong(t, t + 1, memory_order::seq_cst, memory_order::relaxed)) {
+				return nullopt;
+			}
+			return value;
+		}
+
+		[[nodiscard]] size_t size_approx() const {
+			auto b = bottom->load(memory_order::relaxed);
+			auto t = top->load(memory_order::relaxed);
+			return b > t ? static_cast<size_t>(b - t) : 0;
+		}
+
+	private:
+		struct Buffer {
+			atomic<T>& slot(ptrdiff_t index) {
+				return slots[static_cast<size_t>(index) & mask];
+			}
+
+			size_t mask;
+			Buffer* retired;
+			atomic<T>* slots;
+		};
+
+		static constexpr size_t SLOTS_OFFSET = (sizeof(Buffer) + alignof(atomic<T>) - 1) & ~(alignof(atomic<T>) - 1);
+
+		static constexpr size_t buffer_size(size_t capacity) {
+			return SLOTS_OFFSET + capacity * sizeof(atomic<T>);
+		}
+
+		Buffer* allocate_buffer(size_t capacity) {
+			auto* ptr = static_cast<char*>(alloc.allocate(buffer_size(capacity)));
+			if (!ptr) {
+				return nullptr;
+			}
+
+			auto* slots = reinterpret_cast<atomic<T>*>(ptr + SLOTS_OFFSET);
+			for (size_t i = 0; i < capacity; ++i) {
+				new (&slots[i]) atomic<T> {};
+			}
+			return new (ptr) Buffer {.mask {capacity - 1}, .retired {}, .slots {slots}};
+		}
+
+		void free_buffer(Buffer* buffer) {
+			if constexpr (SizedAllocator<Allocator>) {
+				alloc.deallocate(buffer, buffer_size(buffer->mask + 1));
+			}
+			else {
+				alloc.deallocate(buffer);
+			}
+		}
+
+		Buffer* grow(Buffer* old, ptrdiff_t t, ptrdiff_t b) {
+			auto* buffer = allocate_buffer(old ? (old->mask + 1) * 2 : 1);
+			if (!buffer) {
+				return nullptr;
+			}
+
+			if (old) {
+				for (auto i = t; i < b; ++i) {
+					buffer->slot(i).store(old->slot(i).load(memory_order::relaxed), memory_order::relaxed);
+				}
+				buffer->retired = old;
+			}
+			array.store(buffer, memory_order::release);
+			return buffer;
+		}
+
+		cache_padded<atomic<ptrdiff_t>> top {};
+		cache_padded<atomic<ptrdiff_t>> bottom {};
+		atomic<Buffer*> array {};
+		Allocator alloc;
+	};
+}
@@ -4,7 +4,13 @@
 #include <hz/manually_init.hpp>
 #include <hz/double_list.hpp>
 #include <hz/spinlock.hpp>
+#include <hz/ticket_spinlock.hpp>
+#include <hz/mcs_spinlock.hpp>
+#include <hz/rw_spinlock.hpp>
+#include <hz/seqlock.hpp>
+#include <hz/mutex.hpp>
 #include <hz/atomic.hpp>
+#include <hz/cache_padded.hpp>
 #include <hz/bit.hpp>
 #include <hz/vector.hpp>
 #include <hz/optional.hpp>
@@ -15,7 +21,25 @@
 #include <hz/string_utils.hpp>
 #include <hz/rb_tree.hpp>
 #include <hz/slab.hpp>
+#include <hz/tlsf.hpp>
+#include <hz/alloc_trace.hpp>
+#include <hz/epoch.hpp>
+#include <hz/hazard_pointer.hpp>
+#include <hz/spsc_ring.hpp>
+#include <hz/mpmc_queue.hpp>
+#include <hz/mpsc_queue.hpp>
+#include <hz/work_stealing_deque.hpp>
+#include <hz/thread_pool.hpp>
+#include <hz/sharded_counter.hpp>
+#include <hz/flat_combining.hpp>
+#include <hz/latch.hpp>
+#include <hz/barrier.hpp>
+#include <hz/event.hpp>
+#include <hz/concurrent_skip_list.hpp>
+#include <chrono>
 #include <compare>
+#include <memory>
+#include <thread>
 
 TEST(Basic, StringView) {
 	hz::string_view hello {"hello"};
@@ -134,6 +158,396 @@ TEST(Basic, Spinlock) {
 		EXPECT_EQ(*guard, 2);
 		EXPECT_EQ(lock.get_unsafe(), 2);
 	}
+
+	hz::spinlock<int, hz::exponential_backoff<1, 64, hz::thread_yield>, hz::lock_stats> counted {};
+	std::thread threads[4];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (int i = 0; i < 1000; ++i) {
+				auto guard = counted.lock();
+				++*guard;
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(counted.get_unsafe(), 4000);
+	EXPECT_EQ(counted.stats().get_acquisitions(), 4000);
+	EXPECT_LE(counted.stats().get_contended(), 4000);
+
+	// an acquisition counts as contended as soon as the first attempt fails
+	hz::spinlock<int, hz::exponential_backoff<1, 64, hz::thread_yield>, hz::lock_stats> held {};
+	std::thread waiter;
+	{
+		auto guard = held.lock();
+		waiter = std::thread {[&] {
+			auto guard = held.lock();
+		}};
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	waiter.join();
+	EXPECT_EQ(held.stats().get_acquisitions(), 2);
+	EXPECT_EQ(held.stats().get_contended(), 1);
+
+	hz::spinlock<void, hz::pause_backoff, hz::lock_stats> void_lock;
+	{
+		auto guard = void_lock.lock();
+	}
+	EXPECT_EQ(void_lock.stats().get_acquisitions(), 1);
+	EXPECT_EQ(void_lock.stats().get_contended(), 0);
+	static_assert(sizeof(hz::spinlock<void>) == 1);
+
+	{
+		auto guard = lock.try_lock();
+		ASSERT_TRUE(guard);
+		EXPECT_EQ(**guard, 2);
+		EXPECT_FALSE(lock.try_lock());
+		EXPECT_FALSE(lock.try_lock_for(100));
+	}
+	EXPECT_TRUE(lock.try_lock_for(100));
+
+	{
+		auto guard = void_lock.try_lock();
+		EXPECT_TRUE(guard);
+		EXPECT_FALSE(void_lock.try_lock_for(10));
+	}
+	EXPECT_TRUE(void_lock.try_lock());
+	EXPECT_EQ(void_lock.stats().get_acquisitions(), 3);
+}
+
+TEST(Basic, TicketSpinlock) {
+	hz::ticket_spinlock<int> lock {1};
+	{
+		auto guard = lock.lock();
+		EXPECT_EQ(*guard, 1);
+		++*guard;
+	}
+	EXPECT_EQ(lock.get_unsafe(), 2);
+
+	hz::ticket_spinlock<void> void_lock;
+	int value = 0;
+	std::thread threads[4];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (int i = 0; i < 1000; ++i) {
+				{
+					auto guard = lock.lock();
+					++*guard;
+				}
+				auto guard = void_lock.lock();
+				++value;
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(lock.get_unsafe(), 4002);
+	EXPECT_EQ(value, 4000);
+}
+
+TEST(Basic, McsSpinlock) {
+	hz::mcs_spinlock<int> lock {1};
+	{
+		auto guard = lock.lock();
+		EXPECT_EQ(*guard, 1);
+		++*guard;
+	}
+	EXPECT_EQ(lock.get_unsafe(), 2);
+
+	hz::mcs_spinlock<void> void_lock;
+	int value = 0;
+	std::thread threads[4];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (int i = 0; i < 1000; ++i) {
+				{
+					auto guard = lock.lock();
+					++*guard;
+				}
+				auto guard = void_lock.lock();
+				++value;
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(lock.get_unsafe(), 4002);
+	EXPECT_EQ(value, 4000);
+
+	struct ArenaAllocator {
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr, size_t) {
+			return free(ptr);
+		}
+	};
+
+	hz::slab_allocator<ArenaAllocator, hz::default_slab_config, hz::slab_trap_verifier, hz::mcs_spinlock> slab {ArenaAllocator {}};
+	auto* ptr = slab.alloc(100);
+	EXPECT_NE(ptr, nullptr);
+	slab.free(ptr);
+}
+
+TEST(Basic, RwSpinlock) {
+	struct Pair {
+		int a;
+		int b;
+	};
+
+	hz::rw_spinlock<Pair> lock {Pair {1, 1}};
+	{
+		auto reader = lock.lock_shared();
+		auto reader2 = lock.lock_shared();
+		EXPECT_EQ(reader->a, 1);
+		EXPECT_EQ((*reader2).b, 1);
+	}
+	{
+		auto writer = lock.lock();
+		++writer->a;
+		++writer->b;
+	}
+	EXPECT_EQ(lock.get_unsafe().a, 2);
+
+	auto run = [](auto& lock) {
+		bool torn = false;
+		std::thread threads[4];
+		for (size_t i = 0; i < 4; ++i) {
+			threads[i] = std::thread {[&, i] {
+				for (int j = 0; j < 1000; ++j) {
+					if (i == 0) {
+						auto guard = lock.lock();
+						++guard->a;
+						++guard->b;
+					}
+					else {
+						auto guard = lock.lock_shared();
+						if (guard->a != guard->b) {
+							torn = true;
+						}
+					}
+				}
+			}};
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		EXPECT_FALSE(torn);
+		EXPECT_EQ(lock.get_unsafe().a, 1000);
+	};
+
+	hz::rw_spinlock<Pair> single {};
+	run(single);
+	hz::rw_spinlock<Pair, 4> sharded {};
+	run(sharded);
+
+	hz::rw_spinlock<void, 2> void_lock;
+	{
+		auto reader = void_lock.lock_shared();
+	}
+	auto writer = void_lock.lock();
+}
+
+TEST(Basic, Seqlock) {
+	struct Calibration {
+		uint64_t a;
+		uint64_t b;
+		uint32_t c;
+	};
+
+	hz::seqlock<Calibration> lock {Calibration {1, 1, 1}};
+	auto value = lock.read();
+	EXPECT_EQ(value.a, 1);
+	EXPECT_EQ(value.c, 1);
+
+	lock.write(Calibration {2, 2, 2});
+	EXPECT_EQ(lock.read().b, 2);
+
+	bool torn = false;
+	std::thread writer {[&] {
+		for (uint64_t i = 3; i < 10000; ++i) {
+			lock.update([&](Calibration& value) {
+				value = {i, i, static_cast<uint32_t>(i)};
+			});
+		}
+	}};
+	std::thread reader {[&] {
+		for (int i = 0; i < 10000; ++i) {
+			auto value = lock.read();
+			if (value.a != value.b || value.a != value.c) {
+				torn = true;
+			}
+		}
+	}};
+	writer.join();
+	reader.join();
+	EXPECT_FALSE(torn);
+	EXPECT_EQ(lock.read().a, 9999);
+}
+
+TEST(Basic, Mutex) {
+	hz::mutex<int> lock {1};
+	{
+		auto guard = lock.lock();
+		EXPECT_EQ(*guard, 1);
+		EXPECT_FALSE(lock.try_lock());
+		++*guard;
+	}
+	EXPECT_TRUE(lock.try_lock());
+
+	auto run = [](auto& lock, auto& value) {
+		std::thread threads[8];
+		for (auto& thread : threads) {
+			thread = std::thread {[&] {
+				for (int i = 0; i < 1000; ++i) {
+					auto guard = lock.lock();
+					++value;
+				}
+			}};
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	};
+
+	hz::mutex<void> void_lock;
+	int value = 0;
+	run(void_lock, value);
+	EXPECT_EQ(value, 8000);
+
+	hz::mutex<void, hz::spin_waiter> spin_lock;
+	value = 0;
+	run(spin_lock, value);
+	EXPECT_EQ(value, 8000);
+}
+
+TEST(Basic, AtomicWait) {
+	auto run = [](auto& flag, auto old, auto new_value) {
+		flag.store(old, hz::memory_order::relaxed);
+		// returns immediately if the value already differs
+		flag.wait(new_value, hz::memory_order::acquire);
+
+		std::thread waiter {[&] {
+			flag.wait(old, hz::memory_order::acquire);
+			EXPECT_EQ(flag.load(hz::memory_order::relaxed), new_value);
+		}};
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+		flag.store(new_value, hz::memory_order::release);
+		flag.notify_all();
+		waiter.join();
+	};
+
+	hz::atomic<uint32_t> word {};
+	run(word, uint32_t {0}, uint32_t {1});
+	hz::atomic<uint64_t> dword {};
+	run(dword, uint64_t {1}, uint64_t {1} << 40);
+	hz::atomic<bool> flag {};
+	run(flag, false, true);
+
+	hz::atomic<uint32_t> counter {};
+	std::thread threads[4];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (int i = 0; i < 100; ++i) {
+				counter.fetch_add(1, hz::memory_order::release);
+				counter.notify_one<hz::spin_waiter>();
+			}
+		}};
+	}
+	for (uint32_t value = 0; value < 400; value = counter.load(hz::memory_order::acquire)) {
+		counter.wait<hz::spin_waiter>(value, hz::memory_order::acquire);
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+TEST(Basic, AtomicWide) {
+	struct TaggedPtr {
+		void* ptr;
+		uint64_t tag;
+	};
+
+	static_assert(hz::atomic<uint32_t>::is_always_lock_free);
+	static_assert(hz::atomic<void*>::is_always_lock_free);
+	static_assert(hz::atomic<TaggedPtr>::is_always_lock_free);
+	static_assert(alignof(hz::atomic<TaggedPtr>) == 16);
+	static_assert(hz::atomic_ref<TaggedPtr>::required_alignment == 16);
+
+	int object = 0;
+	hz::atomic<TaggedPtr> head {TaggedPtr {&object, 0}};
+	EXPECT_TRUE(head.is_lock_free());
+	auto value = head.load(hz::memory_order::acquire);
+	EXPECT_EQ(value.ptr, &object);
+	EXPECT_EQ(value.tag, 0);
+
+	TaggedPtr stale {&object, 5};
+	EXPECT_FALSE(head.compare_exchange_strong(stale, TaggedPtr {nullptr, 1}, hz::memory_order::acq_rel));
+	EXPECT_EQ(stale.tag, 0);
+	EXPECT_TRUE(head.compare_exchange_strong(stale, TaggedPtr {nullptr, 1}, hz::memory_order::acq_rel));
+	EXPECT_EQ(head.exchange(TaggedPtr {&object, 2}, hz::memory_order::acq_rel).tag, 1);
+
+	std::thread threads[4];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (int i = 0; i < 1000; ++i) {
+				auto current = head.load(hz::memory_order::relaxed);
+				while (!head.compare_exchange_weak(
+					current,
+					TaggedPtr {current.ptr, current.tag + 1},
+					hz::memory_order::acq_rel,
+					hz::memory_order::relaxed));
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(head.load(hz::memory_order::relaxed).tag, 4002);
+
+	struct Arena {
+		uint32_t index;
+		uint32_t count;
+	};
+
+	Arena arena {1, 0};
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			hz::atomic_ref count {arena.count};
+			for (int i = 0; i < 1000; ++i) {
+				count.fetch_add(1, hz::memory_order::relaxed);
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(arena.count, 4000);
+
+	alignas(16) TaggedPtr plain {nullptr, 7};
+	hz::atomic_ref ref {plain};
+	ref.store(TaggedPtr {&object, 8}, hz::memory_order::release);
+	EXPECT_EQ(plain.ptr, &object);
+	EXPECT_EQ(ref.load(hz::memory_order::acquire).tag, 8);
+}
+
+TEST(Basic, CachePadded) {
+	static_assert(alignof(hz::cache_padded<char>) == hz::hardware_destructive_interference_size);
+	static_assert(sizeof(hz::cache_padded<char>) == hz::hardware_destructive_interference_size);
+	static_assert(sizeof(hz::cache_padded<char[100]>) % hz::hardware_destructive_interference_size == 0);
+
+	hz::cache_padded<hz::spinlock<int>> locks[4] {};
+	auto distance = reinterpret_cast<uintptr_t>(&locks[1]) - reinterpret_cast<uintptr_t>(&locks[0]);
+	EXPECT_EQ(distance, hz::hardware_destructive_interference_size);
+	*locks[1]->lock() = 5;
+	EXPECT_EQ((*locks[1]).get_unsafe(), 5);
+
+	hz::cache_padded<int> value {3};
+	EXPECT_EQ(*value, 3);
 }
 
 TEST(Basic, Bit) {
@@ -266,6 +680,39 @@ TEST(Basic, Vector) {
 	for (auto& item : vec) {
 		EXPECT_EQ(item, 0);
 	}
+
+	struct RoundingAllocator {
+		static hz::allocation_result allocate_at_least(size_t size) {
+			size = (size + 63) & ~63;
+			return {malloc(size), size};
+		}
+
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr) {
+			return free(ptr);
+		}
+	};
+	static_assert(hz::AtLeastAllocator<RoundingAllocator>);
+	static_assert(!hz::AtLeastAllocator<Allocator>);
+
+	hz::vector<int, RoundingAllocator> vec3 {RoundingAllocator {}};
+	vec3.push_back(1);
+	// the initial 8 elements are rounded up to a 64 byte block
+	EXPECT_EQ(vec3.capacity(), 16);
+	for (int i = 0; i < 16; ++i) {
+		vec3.push_back(i);
+	}
+	// growing to 24 elements rounds up to 128 bytes
+	EXPECT_EQ(vec3.capacity(), 32);
+	EXPECT_EQ(vec3[0], 1);
+
+	hz::string<RoundingAllocator> str {RoundingAllocator {}};
+	str += "hello";
+	EXPECT_EQ(str.capacity(), 63);
+	EXPECT_EQ(str, hz::string_view {"hello"});
 }
 
 TEST(Basic, Optional) {
@@ -413,6 +860,47 @@ TEST(Basic, RbTree) {
 	EXPECT_EQ((tree.find<int, &Node::key>(4)), nullptr);
 	EXPECT_EQ((tree.find<int, &Node::key>(2)), &b);
 	EXPECT_EQ((tree.find<int, &Node::key>(100)), &c);
+
+	EXPECT_EQ(tree.insert(&a), true);
+	EXPECT_EQ(tree.insert(&d), true);
+	EXPECT_EQ((tree.lower_bound<int, &Node::key>(2)), &b);
+	EXPECT_EQ((tree.lower_bound<int, &Node::key>(3)), &d);
+	EXPECT_EQ((tree.lower_bound<int, &Node::key>(101)), nullptr);
+	EXPECT_EQ((tree.upper_bound<int, &Node::key>(2)), &d);
+	EXPECT_EQ((tree.upper_bound<int, &Node::key>(0)), &a);
+	EXPECT_EQ((tree.upper_bound<int, &Node::key>(100)), nullptr);
+	EXPECT_EQ((tree.find_le<int, &Node::key>(2)), &b);
+	EXPECT_EQ((tree.find_le<int, &Node::key>(99)), &d);
+	EXPECT_EQ((tree.find_le<int, &Node::key>(0)), nullptr);
+
+	int keys[4] {};
+	int count = 0;
+	for (auto& node : tree) {
+		keys[count++] = node.key;
+	}
+	EXPECT_EQ(count, 4);
+	EXPECT_EQ(keys[0], 1);
+	EXPECT_EQ(keys[3], 100);
+
+	count = 0;
+	for (auto& node : tree.range<int, &Node::key>(2, 100)) {
+		keys[count++] = node.key;
+	}
+	EXPECT_EQ(count, 2);
+	EXPECT_EQ(keys[0], 2);
+	EXPECT_EQ(keys[1], 4);
+
+	count = 0;
+	for ([[maybe_unused]] auto& node : tree.range<int, &Node::key>(5, 100)) {
+		++count;
+	}
+	EXPECT_EQ(count, 0);
+
+	// the current node may be removed while iterating
+	for (auto& node : tree.range<int, &Node::key>(0, 50)) {
+		tree.remove(&node);
+	}
+	EXPECT_EQ(tree.get_first(), &c);
 }
 
 TEST(Basic, Slab) {
@@ -431,15 +919,15 @@ TEST(Basic, Slab) {
 	auto ptr = alloc.alloc(1);
 	EXPECT_NE(ptr, nullptr);
 	memset(ptr, 0xAB, 1);
-	EXPECT_EQ(alloc.get_size_for_allocation(ptr), 1);
+	EXPECT_EQ(alloc.get_size_for_allocation(ptr), 16);
 	auto ptr2 = alloc.alloc(8);
 	EXPECT_NE(ptr2, nullptr);
 	memset(ptr2, 0xCD, 8);
-	EXPECT_EQ(alloc.get_size_for_allocation(ptr2), 8);
+	EXPECT_EQ(alloc.get_size_for_allocation(ptr2), 16);
 	auto ptr3 = alloc.alloc(31);
 	EXPECT_NE(ptr3, nullptr);
 	memset(ptr3, 0x78, 31);
-	EXPECT_EQ(alloc.get_size_for_allocation(ptr3), 31);
+	EXPECT_EQ(alloc.get_size_for_allocation(ptr3), 32);
 	auto ptr4 = alloc.alloc(2048);
 	EXPECT_NE(ptr4, nullptr);
 	memset(ptr4, 0x56, 2048);
@@ -447,7 +935,7 @@ TEST(Basic, Slab) {
 	auto ptr5 = alloc.alloc(4097);
 	EXPECT_NE(ptr5, nullptr);
 	memset(ptr5, 0x32, 4097);
-	EXPECT_EQ(alloc.get_size_for_allocation(ptr5), 4097);
+	EXPECT_EQ(alloc.get_size_for_allocation(ptr5), 8192);
 	auto ptr6 = alloc.alloc(1024 * 256);
 	EXPECT_NE(ptr6, nullptr);
 	memset(ptr6, 0x54, 1024 * 256);
@@ -458,6 +946,957 @@ TEST(Basic, Slab) {
 	alloc.free(ptr2);
 	alloc.free(ptr6);
 	alloc.free(ptr4);
+
+	auto result = alloc.alloc_at_least(20);
+	EXPECT_NE(result.ptr, nullptr);
+	EXPECT_EQ(result.count, 32);
+	alloc.free(result.ptr);
+	result = alloc.alloc_at_least(5000);
+	EXPECT_EQ(result.count, 8192);
+	alloc.free(result.ptr);
+
+	static int double_frees = 0;
+	struct Verifier {
+		static void double_free_or_corruption() {
+			++double_frees;
+		}
+
+		static void invalid_config(const char*) {
+			__builtin_trap();
+		}
+	};
+
+	hz::slab_allocator<ArenaAllocator, hz::default_slab_config, Verifier> checked {ArenaAllocator {}};
+	auto small = checked.alloc(16);
+	auto small2 = checked.alloc(16);
+	auto large = checked.alloc(1024 * 256);
+	checked.free(small);
+	checked.free(small);
+	EXPECT_EQ(double_frees, 1);
+	checked.free(static_cast<char*>(small2) + 1);
+	EXPECT_EQ(double_frees, 2);
+	checked.free(large);
+	checked.free(large);
+	EXPECT_EQ(double_frees, 3);
+	checked.free(small2);
+	EXPECT_EQ(double_frees, 3);
 }
 
+TEST(Basic, SlabThreadCache) {
+	static size_t reserved = 0;
+	struct ArenaAllocator {
+		static void* allocate(size_t size) {
+			reserved += size;
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr, size_t size) {
+			reserved -= size;
+			return free(ptr);
+		}
+	};
+
+	using Slab = hz::slab_allocator<ArenaAllocator>;
+	Slab alloc {ArenaAllocator {}};
 
+	{
+		Slab::thread_cache cache {alloc};
+		auto ptr = alloc.alloc(24, cache);
+		EXPECT_NE(ptr, nullptr);
+		EXPECT_EQ(alloc.get_size_for_allocation(ptr), 32);
+		alloc.free(ptr, cache);
+		// the block stays cached and is handed out again
+		auto ptr2 = alloc.alloc(20, cache);
+		EXPECT_EQ(ptr2, ptr);
+		EXPECT_EQ(alloc.get_size_for_allocation(ptr2), 32);
+		alloc.free(ptr2, cache);
+		auto ptr3 = alloc.alloc(4096, cache);
+		alloc.free(ptr3, cache);
+		// large allocations are not in the page map and take the locked path
+		auto ptr4 = alloc.alloc(1024 * 256, cache);
+		EXPECT_EQ(alloc.get_size_for_allocation(ptr4), 1024 * 256);
+		alloc.free(ptr4, cache);
+
+		// the cache was used since the last scavenge so it is left alone the first time
+		EXPECT_EQ(alloc.scavenge(), 0);
+		EXPECT_EQ(alloc.scavenge(), 1);
+		EXPECT_EQ(reserved, 0);
+
+		ptr = alloc.alloc(8, cache);
+		alloc.free(ptr, cache);
+		EXPECT_NE(reserved, 0);
+		EXPECT_EQ(cache.flush(), 1);
+		EXPECT_EQ(reserved, 0);
+	}
+
+	std::thread thread {[&] {
+		thread_local Slab::thread_cache cache {alloc};
+		void* ptrs[100];
+		for (auto& ptr : ptrs) {
+			ptr = alloc.alloc(16, cache);
+		}
+		for (auto* ptr : ptrs) {
+			alloc.free(ptr, cache);
+		}
+	}};
+	thread.join();
+	// the cache was flushed when the thread exited
+	EXPECT_EQ(reserved, 0);
+
+	// the blocks of a thread that stays blocked are returned by scavenge
+	hz::event filled;
+	hz::event done;
+	std::thread blocked {[&] {
+		Slab::thread_cache cache {alloc};
+		void* ptrs[16];
+		for (auto& ptr : ptrs) {
+			ptr = alloc.alloc(64, cache);
+		}
+		for (auto* ptr : ptrs) {
+			alloc.free(ptr, cache);
+		}
+		filled.set();
+		done.wait();
+	}};
+	filled.wait();
+	EXPECT_NE(reserved, 0);
+	EXPECT_EQ(alloc.scavenge(), 0);
+	EXPECT_EQ(alloc.scavenge(), 16);
+	EXPECT_EQ(reserved, 0);
+	done.set();
+	blocked.join();
+}
+
+TEST(Basic, Tlsf) {
+	static_assert(hz::UnsizedAllocator<hz::tlsf_allocator<>::unsized_ref>);
+	static_assert(hz::SizedAllocator<hz::tlsf_allocator<>::sized_ref>);
+
+	constexpr size_t POOL_SIZE = 1024 * 64;
+	auto* pool = malloc(POOL_SIZE);
+	{
+		hz::tlsf_allocator alloc {pool, POOL_SIZE};
+
+		auto ptr = alloc.alloc(1);
+		EXPECT_NE(ptr, nullptr);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % (2 * sizeof(void*)), 0);
+		EXPECT_GE(alloc.get_usable_size(ptr), 1);
+		memset(ptr, 0xAB, 1);
+		auto ptr2 = alloc.alloc(100);
+		EXPECT_NE(ptr2, nullptr);
+		EXPECT_GE(alloc.get_usable_size(ptr2), 100);
+		memset(ptr2, 0xCD, 100);
+		auto ptr3 = alloc.alloc(4097);
+		EXPECT_NE(ptr3, nullptr);
+		EXPECT_GE(alloc.get_usable_size(ptr3), 4097);
+		memset(ptr3, 0x78, 4097);
+		EXPECT_EQ(alloc.alloc(POOL_SIZE), nullptr);
+
+		alloc.free(ptr2);
+		auto ptr4 = alloc.alloc(64);
+		EXPECT_EQ(ptr4, ptr2);
+		alloc.free(ptr);
+		alloc.free(ptr3);
+		alloc.free(ptr4);
+
+		// everything was coalesced back into a single block
+		auto big = alloc.alloc(POOL_SIZE / 2);
+		EXPECT_NE(big, nullptr);
+		alloc.free(big);
+
+		hz::vector<int, hz::tlsf_allocator<>::sized_ref> vec {alloc.as_sized()};
+		for (int i = 0; i < 1000; ++i) {
+			vec.push_back(i);
+		}
+		EXPECT_EQ(vec[999], 999);
+	}
+	free(pool);
+}
+
+TEST(Basic, AllocTrace) {
+	struct Sink {
+		void write(const void* data, size_t size) {
+			auto* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; ++i) {
+				log->push_back(bytes[i]);
+			}
+		}
+
+		hz::vector<uint8_t, Allocator>* log;
+	};
+
+	struct Env {
+		static uint64_t timestamp() {
+			static uint64_t time = 0;
+			return time += 10;
+		}
+
+		static uint32_t thread_id() {
+			return 3;
+		}
+	};
+
+	hz::vector<uint8_t, Allocator> log {Allocator {}};
+	uintptr_t addrs[3] {};
+	{
+		hz::alloc_tracer<Sink, Env> tracer {Sink {&log}};
+		hz::tracing_allocator<Allocator, decltype(tracer)> alloc {Allocator {}, &tracer};
+		static_assert(hz::UnsizedAllocator<decltype(alloc)>);
+
+		auto* a = alloc.allocate(100);
+		auto* b = alloc.allocate(1);
+		addrs[0] = reinterpret_cast<uintptr_t>(a);
+		addrs[1] = reinterpret_cast<uintptr_t>(b);
+		alloc.deallocate(a);
+		auto* c = alloc.allocate(1 << 20);
+		addrs[2] = reinterpret_cast<uintptr_t>(c);
+		alloc.deallocate(c);
+		alloc.deallocate(b);
+	}
+
+	struct {
+		hz::alloc_trace_op op;
+		uintptr_t ptr;
+		size_t size;
+	} expected[] {
+		{hz::alloc_trace_op::alloc, addrs[0], 100},
+		{hz::alloc_trace_op::alloc, addrs[1], 1},
+		{hz::alloc_trace_op::free, addrs[0], 0},
+		{hz::alloc_trace_op::alloc, addrs[2], 1 << 20},
+		{hz::alloc_trace_op::free, addrs[2], 0},
+		{hz::alloc_trace_op::free, addrs[1], 0},
+	};
+
+	hz::alloc_trace_reader reader {log.data(), log.size()};
+	hz::alloc_trace_event event {};
+	uint64_t last_timestamp = 0;
+	for (auto& entry : expected) {
+		ASSERT_TRUE(reader.next(event));
+		EXPECT_EQ(event.op, entry.op);
+		EXPECT_EQ(event.ptr, entry.ptr);
+		EXPECT_EQ(event.size, entry.size);
+		EXPECT_EQ(event.thread, 3);
+		EXPECT_GT(event.timestamp, last_timestamp);
+		last_timestamp = event.timestamp;
+	}
+	EXPECT_FALSE(reader.next(event));
+
+	struct RoundingAllocator {
+		static hz::allocation_result allocate_at_least(size_t size) {
+			size = (size + 63) & ~63;
+			return {malloc(size), size};
+		}
+
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr, size_t) {
+			return free(ptr);
+		}
+	};
+
+	log.clear();
+	{
+		hz::alloc_tracer<Sink, Env> tracer {Sink {&log}};
+		hz::tracing_allocator<RoundingAllocator, decltype(tracer)> alloc {RoundingAllocator {}, &tracer};
+		static_assert(hz::SizedAllocator<decltype(alloc)>);
+		auto result = alloc.allocate_at_least(10);
+		EXPECT_EQ(result.count, 64);
+		alloc.deallocate(result.ptr, result.count);
+	}
+
+	// the requested size is traced, not the granted one
+	reader = hz::alloc_trace_reader {log.data(), log.size()};
+	ASSERT_TRUE(reader.next(event));
+	EXPECT_EQ(event.size, 10);
+}
+
+TEST(Basic, Epoch) {
+	struct Node : hz::epoch_hook {
+		int value;
+	};
+
+	auto reclaim = [](hz::epoch_hook* hook, void* context) {
+		++*static_cast<size_t*>(context);
+		delete static_cast<Node*>(hook);
+	};
+
+	size_t reclaimed = 0;
+	hz::epoch_domain domain {&reclaimed, 4};
+	{
+		hz::epoch_domain::thread_record writer {domain};
+		hz::epoch_domain::thread_record reader {domain};
+
+		reader.enter();
+		writer.retire(new Node {{}, 1}, reclaim);
+		// the reader pinned the old epoch so it can advance only once
+		EXPECT_EQ(writer.collect(), 0);
+		EXPECT_EQ(writer.collect(), 0);
+		EXPECT_EQ(domain.get_epoch(), 1);
+		reader.exit();
+		EXPECT_EQ(writer.collect(), 1);
+		EXPECT_EQ(reclaimed, 1);
+
+		{
+			auto guard = reader.pin();
+			auto nested = reader.pin();
+			writer.retire(new Node {{}, 2}, reclaim);
+		}
+		// left to the domain when the writer exits
+	}
+	EXPECT_EQ(domain.drain(), 1);
+	EXPECT_EQ(reclaimed, 2);
+
+	hz::atomic<Node*> current {new Node {{}, 0}};
+	bool bad_value = false;
+	std::thread readers[3];
+	for (auto& thread : readers) {
+		thread = std::thread {[&] {
+			hz::epoch_domain::thread_record record {domain};
+			for (int i = 0; i < 10000; ++i) {
+				auto guard = record.pin();
+				auto* node = current.load(hz::memory_order::acquire);
+				if (node->value < 0) {
+					bad_value = true;
+				}
+			}
+		}};
+	}
+	std::thread writer_thread {[&] {
+		hz::epoch_domain::thread_record record {domain};
+		for (int i = 1; i < 1000; ++i) {
+			auto* old = current.exchange(new Node {{}, i}, hz::memory_order::acq_rel);
+			record.retire(old, reclaim);
+		}
+	}};
+	for (auto& thread : readers) {
+		thread.join();
+	}
+	writer_thread.join();
+	domain.drain();
+	EXPECT_FALSE(bad_value);
+	EXPECT_EQ(reclaimed, 1001);
+	delete current.load(hz::memory_order::relaxed);
+}
+
+TEST(Basic, HazardPointer) {
+	struct Node : hz::hazard_hook {
+		int value;
+		Node* next_node;
+	};
+
+	using Domain = hz::hazard_domain<1>;
+	auto reclaim = [](hz::hazard_hook* hook, void* context) {
+		static_cast<hz::atomic<size_t>*>(context)->fetch_add(1, hz::memory_order::relaxed);
+		delete static_cast<Node*>(hook);
+	};
+
+	// reclaim callbacks of different threads can run concurrently
+	hz::atomic<size_t> reclaimed {};
+	Domain domain {&reclaimed, 8};
+	hz::atomic<Node*> head {};
+
+	auto push = [&](int value) {
+		auto* node = new Node {{}, value, head.load(hz::memory_order::relaxed)};
+		while (!head.compare_exchange_weak(node->next_node, node, hz::memory_order::release, hz::memory_order::relaxed));
+	};
+	auto pop = [&](Domain::thread_record& record) -> int {
+		while (true) {
+			auto* node = record.protect(0, head);
+			if (!node) {
+				return -1;
+			}
+			// safe to dereference, node can't be reclaimed while protected
+			auto* next = node->next_node;
+			if (head.compare_exchange_strong(node, next, hz::memory_order::acquire, hz::memory_order::relaxed)) {
+				record.reset(0);
+				int value = node->value;
+				record.retire(node, reclaim);
+				return value;
+			}
+		}
+	};
+
+	{
+		Domain::thread_record record {domain};
+		push(1);
+		auto* node = record.protect(0, head);
+		EXPECT_EQ(node->value, 1);
+		head.store(nullptr, hz::memory_order::relaxed);
+		record.retire(node, reclaim);
+		// still protected by our own slot
+		EXPECT_EQ(record.scan(), 0);
+		EXPECT_EQ(domain.get_unreclaimed(), 1);
+		record.reset(0);
+		EXPECT_EQ(record.scan(), 1);
+		EXPECT_EQ(domain.get_unreclaimed(), 0);
+
+		// callbacks run without the domain lock, so they may register records or retire again
+		static Domain* callback_domain;
+		callback_domain = &domain;
+		record.retire(new Node {}, [](hz::hazard_hook* hook, void* context) {
+			Domain::thread_record nested {*callback_domain};
+			static_cast<hz::atomic<size_t>*>(context)->fetch_add(1, hz::memory_order::relaxed);
+			delete static_cast<Node*>(hook);
+		});
+		EXPECT_EQ(record.scan(), 1);
+		EXPECT_EQ(domain.get_unreclaimed(), 0);
+	}
+
+	hz::atomic<int> sum {};
+	std::thread threads[4];
+	for (int i = 0; i < 4; ++i) {
+		threads[i] = std::thread {[&, i] {
+			Domain::thread_record record {domain};
+			for (int j = 0; j < 1000; ++j) {
+				push(i * 1000 + j);
+				int value = pop(record);
+				if (value >= 0) {
+					sum.fetch_add(value, hz::memory_order::relaxed);
+				}
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	Domain::thread_record record {domain};
+	while (true) {
+		int value = pop(record);
+		if (value < 0) {
+			break;
+		}
+		sum.fetch_add(value, hz::memory_order::relaxed);
+	}
+	EXPECT_EQ(sum.load(hz::memory_order::relaxed), 3999 * 4000 / 2);
+	record.scan();
+	domain.drain();
+	EXPECT_EQ(domain.get_unreclaimed(), 0);
+	EXPECT_EQ(reclaimed.load(hz::memory_order::relaxed), 4002);
+}
+
+TEST(Basic, SpscRing) {
+	hz::spsc_ring<hz::string<Allocator>, 4> ring;
+	EXPECT_EQ(ring.get_capacity(), 4);
+	EXPECT_FALSE(ring.try_pop());
+	for (int i = 0; i < 4; ++i) {
+		hz::string<Allocator> str {Allocator {}};
+		str += static_cast<char>('a' + i);
+		EXPECT_TRUE(ring.try_push(std::move(str)));
+	}
+	EXPECT_FALSE(ring.try_push(hz::string<Allocator> {Allocator {}}));
+	EXPECT_EQ(ring.size_approx(), 4);
+	auto value = ring.try_pop();
+	ASSERT_TRUE(value);
+	EXPECT_EQ(strcmp(value->data(), "a"), 0);
+	// the remaining strings are destroyed with the ring
+
+	struct ArenaAllocator {
+		static void* allocate(size_t size) {
+			return malloc(size);
+		}
+
+		static void deallocate(void* ptr, size_t) {
+			return free(ptr);
+		}
+	};
+
+	hz::dynamic_spsc_ring<uint32_t, ArenaAllocator> dynamic {100, ArenaAllocator {}};
+	EXPECT_EQ(dynamic.get_capacity(), 128);
+
+	uint32_t batch[200];
+	for (uint32_t i = 0; i < 200; ++i) {
+		batch[i] = i;
+	}
+	EXPECT_EQ(dynamic.push_batch(batch, 200), 128);
+	uint32_t out[50];
+	EXPECT_EQ(dynamic.pop_batch(out, 50), 50);
+	EXPECT_EQ(out[49], 49);
+	EXPECT_EQ(dynamic.push_batch(batch + 128, 72), 50);
+	EXPECT_EQ(dynamic.size_approx(), 128);
+
+	size_t received = 0;
+	bool in_order = true;
+	std::thread consumer {[&] {
+		uint32_t expected = 50;
+		while (expected < 100178) {
+			uint32_t values[16];
+			auto count = dynamic.pop_batch(values, 16);
+			for (size_t i = 0; i < count; ++i) {
+				if (values[i] != (expected < 178 ? expected : expected - 178 + 1000)) {
+					in_order = false;
+				}
+				++expected;
+			}
+			received += count;
+		}
+	}};
+	for (uint32_t i = 0; i < 100000; ++i) {
+		while (!dynamic.try_push(i + 1000));
+	}
+	consumer.join();
+	EXPECT_TRUE(in_order);
+	EXPECT_EQ(received, 100128);
+}
+
+TEST(Basic, MpmcQueue) {
+	hz::mpmc_queue<hz::string<Allocator>, Allocator> queue {3, Allocator {}};
+	EXPECT_EQ(queue.get_capacity(), 4);
+	EXPECT_FALSE(queue.try_pop());
+	for (int i = 0; i < 4; ++i) {
+		hz::string<Allocator> str {Allocator {}};
+		str += static_cast<char>('a' + i);
+		EXPECT_TRUE(queue.try_push(std::move(str)));
+	}
+	EXPECT_FALSE(queue.try_push(hz::string<Allocator> {Allocator {}}));
+	auto value = queue.try_pop();
+	ASSERT_TRUE(value);
+	EXPECT_EQ(strcmp(value->data(), "a"), 0);
+	// the remaining strings are destroyed with the queue
+
+	constexpr uint32_t THREADS = 3;
+	constexpr uint32_t COUNT = 20000;
+	hz::mpmc_queue<uint32_t, Allocator, true> blocking {8, Allocator {}};
+	hz::atomic<uint64_t> sum {};
+	std::thread threads[THREADS * 2];
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		threads[i * 2] = std::thread {[&, i] {
+			for (uint32_t j = 0; j < COUNT; ++j) {
+				blocking.push(i * COUNT + j);
+			}
+		}};
+		threads[i * 2 + 1] = std::thread {[&] {
+			uint64_t local = 0;
+			for (uint32_t j = 0; j < COUNT; ++j) {
+				local += blocking.pop();
+			}
+			sum.fetch_add(local, hz::memory_order::relaxed);
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	constexpr uint64_t TOTAL = THREADS * COUNT;
+	EXPECT_EQ(sum.load(hz::memory_order::relaxed), TOTAL * (TOTAL - 1) / 2);
+	EXPECT_FALSE(blocking.try_pop());
+}
+
+TEST(Basic, MpscQueue) {
+	struct Item {
+		hz::list_hook hook {};
+		uint32_t producer;
+		uint32_t value;
+	};
+
+	hz::mpsc_queue<Item, &Item::hook> queue;
+	EXPECT_TRUE(queue.empty());
+	EXPECT_FALSE(queue.pop());
+
+	Item items[3] {};
+	for (auto& item : items) {
+		queue.push(&item);
+	}
+	EXPECT_FALSE(queue.empty());
+	for (auto& item : items) {
+		EXPECT_EQ(queue.pop(), &item);
+	}
+	EXPECT_FALSE(queue.pop());
+	EXPECT_TRUE(queue.empty());
+	// values can be requeued once popped
+	queue.push(&items[1]);
+	EXPECT_EQ(queue.pop(), &items[1]);
+
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t COUNT = 20000;
+	auto storage = std::make_unique<Item[]>(THREADS * COUNT);
+	std::thread producers[THREADS];
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		producers[i] = std::thread {[&, i] {
+			for (uint32_t j = 0; j < COUNT; ++j) {
+				auto& item = storage[i * COUNT + j];
+				item.producer = i;
+				item.value = j;
+				queue.push(&item);
+			}
+		}};
+	}
+
+	uint32_t next[THREADS] {};
+	bool in_order = true;
+	for (uint32_t received = 0; received < THREADS * COUNT;) {
+		if (auto* item = queue.pop()) {
+			if (item->value != next[item->producer]++) {
+				in_order = false;
+			}
+			++received;
+		}
+	}
+	for (auto& thread : producers) {
+		thread.join();
+	}
+	EXPECT_TRUE(in_order);
+	EXPECT_TRUE(queue.empty());
+}
+
+TEST(Basic, WorkStealingDeque) {
+	hz::work_stealing_deque<uint32_t, Allocator> deque {2, Allocator {}};
+	EXPECT_FALSE(deque.pop());
+	EXPECT_FALSE(deque.steal());
+	for (uint32_t i = 0; i < 10; ++i) {
+		EXPECT_TRUE(deque.push(i));
+	}
+	EXPECT_EQ(deque.size_approx(), 10);
+	EXPECT_EQ(*deque.pop(), 9);
+	EXPECT_EQ(*deque.steal(), 0);
+	EXPECT_EQ(*deque.steal(), 1);
+	EXPECT_EQ(*deque.pop(), 8);
+	EXPECT_EQ(deque.size_approx(), 6);
+	while (deque.pop());
+	EXPECT_EQ(deque.size_approx(), 0);
+
+	constexpr uint32_t THIEVES = 3;
+	constexpr uint32_t COUNT = 100000;
+	auto taken = std::make_unique<hz::atomic<uint32_t>[]>(COUNT);
+	hz::atomic<bool> done {};
+	std::thread thieves[THIEVES];
+	for (auto& thief : thieves) {
+		thief = std::thread {[&] {
+			while (!done.load(hz::memory_order::acquire)) {
+				if (auto value = deque.steal()) {
+					taken[*value].fetch_add(1, hz::memory_order::relaxed);
+				}
+			}
+		}};
+	}
+	for (uint32_t i = 0; i < COUNT; ++i) {
+		EXPECT_TRUE(deque.push(i));
+		if (i % 3 == 0) {
+			if (auto value = deque.pop()) {
+				taken[*value].fetch_add(1, hz::memory_order::relaxed);
+			}
+		}
+	}
+	while (auto value = deque.pop()) {
+		taken[*value].fetch_add(1, hz::memory_order::relaxed);
+	}
+	done.store(true, hz::memory_order::release);
+	for (auto& thief : thieves) {
+		thief.join();
+	}
+
+	bool exactly_once = true;
+	for (uint32_t i = 0; i < COUNT; ++i) {
+		if (taken[i].load(hz::memory_order::relaxed) != 1) {
+			exactly_once = false;
+		}
+	}
+	EXPECT_TRUE(exactly_once);
+}
+
+TEST(Basic, ThreadPool) {
+	hz::thread_pool<Allocator> pool {3, Allocator {}};
+	EXPECT_EQ(pool.get_thread_count(), 3);
+
+	constexpr size_t COUNT = 100000;
+	auto hits = std::make_unique<hz::atomic<uint32_t>[]>(COUNT);
+	pool.parallel_for(0, COUNT, 7, [&](size_t i) {
+		hits[i].fetch_add(1, hz::memory_order::relaxed);
+	});
+	bool exactly_once = true;
+	for (size_t i = 0; i < COUNT; ++i) {
+		if (hits[i].load(hz::memory_order::relaxed) != 1) {
+			exactly_once = false;
+		}
+	}
+	EXPECT_TRUE(exactly_once);
+
+	// nested loops run on the workers without blocking them
+	hz::atomic<uint64_t> sum {};
+	pool.parallel_for(0, 64, 1, [&](size_t i) {
+		pool.parallel_for(0, 100, 10, [&](size_t j) {
+			sum.fetch_add(i * 100 + j, hz::memory_order::relaxed);
+		});
+	});
+	EXPECT_EQ(sum.load(hz::memory_order::relaxed), 6400 * 6399 / 2);
+
+	// runs on the calling thread without workers
+	hz::thread_pool<Allocator> empty {0, Allocator {}};
+	size_t calls = 0;
+	empty.parallel_for(5, 15, 2, [&](size_t) {
+		++calls;
+	});
+	EXPECT_EQ(calls, 10);
+}
+
+TEST(Basic, ShardedCounter) {
+	hz::sharded_counter<4> counter;
+	EXPECT_EQ(counter.read(), 0);
+	counter.increment();
+	counter.add(10);
+	counter.sub(3);
+	EXPECT_EQ(counter.read(), 8);
+
+	struct FixedShard {
+		static size_t get() {
+			return 2;
+		}
+	};
+	hz::sharded_counter<1, FixedShard> single;
+	single.add(5);
+	EXPECT_EQ(single.read(), 5);
+
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t COUNT = 100000;
+	std::thread threads[THREADS];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			for (uint32_t i = 0; i < COUNT; ++i) {
+				counter.increment();
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(counter.read(), 8 + THREADS * COUNT);
+}
+
+TEST(Basic, FlatCombining) {
+	struct Counter {
+		uint64_t value;
+		uint32_t ops;
+	};
+
+	hz::flat_combining<Counter> combined {Counter {}};
+	{
+		hz::flat_combining<Counter>::thread_record record {combined};
+		record.apply([](Counter& counter) {
+			counter.value += 5;
+		});
+		EXPECT_EQ(record.apply([](Counter& counter) {
+			return counter.value;
+		}), 5);
+		auto str = record.apply([](Counter&) {
+			hz::string<Allocator> str {Allocator {}};
+			str += "combined";
+			return str;
+		});
+		EXPECT_EQ(strcmp(str.data(), "combined"), 0);
+	}
+
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t COUNT = 20000;
+	std::thread threads[THREADS];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			hz::flat_combining<Counter>::thread_record record {combined};
+			for (uint32_t i = 0; i < COUNT; ++i) {
+				auto ops = record.apply([](Counter& counter) {
+					++counter.value;
+					return ++counter.ops;
+				});
+				EXPECT_GT(ops, 0);
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(combined.lock()->value, 5 + THREADS * COUNT);
+	EXPECT_EQ(combined.get_unsafe().ops, THREADS * COUNT);
+}
+
+TEST(Basic, Latch) {
+	hz::latch latch {3};
+	EXPECT_FALSE(latch.try_wait());
+	latch.count_down(2);
+	EXPECT_FALSE(latch.try_wait());
+
+	uint32_t value = 0;
+	std::thread waiter {[&] {
+		latch.wait();
+		EXPECT_EQ(value, 42);
+	}};
+	value = 42;
+	latch.count_down();
+	waiter.join();
+	EXPECT_TRUE(latch.try_wait());
+
+	constexpr uint32_t THREADS = 4;
+	hz::latch<hz::spin_waiter> start {THREADS};
+	hz::atomic<uint32_t> started {};
+	std::thread threads[THREADS];
+	for (auto& thread : threads) {
+		thread = std::thread {[&] {
+			started.fetch_add(1, hz::memory_order::relaxed);
+			start.arrive_and_wait();
+			EXPECT_EQ(started.load(hz::memory_order::relaxed), THREADS);
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+TEST(Basic, Barrier) {
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t PHASES = 200;
+
+	struct Completion {
+		void operator()() {
+			++*phases;
+		}
+
+		uint32_t* phases;
+	};
+
+	uint32_t phases = 0;
+	uint32_t arrivals[THREADS] {};
+	hz::barrier<Completion> barrier {THREADS, Completion {&phases}};
+	bool consistent = true;
+	std::thread threads[THREADS];
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		threads[i] = std::thread {[&, i] {
+			for (uint32_t phase = 0; phase < PHASES; ++phase) {
+				arrivals[i] = phase + 1;
+				barrier.arrive_and_wait();
+				// everyone finished the previous phase and the completion ran exactly once
+				for (auto count : arrivals) {
+					if (count < phase + 1) {
+						consistent = false;
+					}
+				}
+				if (phases < phase + 1) {
+					consistent = false;
+				}
+				barrier.arrive_and_wait();
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_TRUE(consistent);
+	EXPECT_EQ(phases, PHASES * 2);
+
+	hz::barrier<> dropping {2};
+	std::thread dropper {[&] {
+		dropping.arrive_and_drop();
+	}};
+	dropping.arrive_and_wait();
+	dropper.join();
+	// only the remaining thread takes part now
+	dropping.arrive_and_wait();
+	auto token = dropping.arrive();
+	dropping.wait(token);
+}
+
+TEST(Basic, Event) {
+	hz::event event;
+	EXPECT_FALSE(event.is_set());
+
+	uint32_t value = 0;
+	constexpr uint32_t THREADS = 3;
+	std::thread waiters[THREADS];
+	for (auto& waiter : waiters) {
+		waiter = std::thread {[&] {
+			event.wait();
+			EXPECT_EQ(value, 7);
+		}};
+	}
+	value = 7;
+	event.set();
+	event.set();
+	for (auto& waiter : waiters) {
+		waiter.join();
+	}
+	EXPECT_TRUE(event.is_set());
+	event.wait();
+}
+
+TEST(Basic, ConcurrentSkipList) {
+	using Map = hz::concurrent_skip_list<uint32_t, uint64_t, Allocator>;
+	Map map {Allocator {}};
+	{
+		Map::thread_record record {map};
+		EXPECT_FALSE(map.find(record, 1));
+		EXPECT_TRUE(map.insert(record, 5, 50));
+		EXPECT_TRUE(map.insert(record, 1, 10));
+		EXPECT_TRUE(map.insert(record, 3, 30));
+		EXPECT_FALSE(map.insert(record, 3, 31));
+		EXPECT_EQ(*map.find(record, 3), 30);
+		EXPECT_TRUE(map.contains(record, 1));
+		EXPECT_FALSE(map.contains(record, 2));
+
+		uint64_t sum = 0;
+		uint32_t last = 0;
+		bool ordered = true;
+		map.scan(record, 2, 6, [&](const uint32_t& key, const uint64_t& value) {
+			ordered = ordered && key > last;
+			last = key;
+			sum += value;
+		});
+		EXPECT_TRUE(ordered);
+		EXPECT_EQ(sum, 80);
+
+		EXPECT_TRUE(map.remove(record, 3));
+		EXPECT_FALSE(map.remove(record, 3));
+		EXPECT_FALSE(map.find(record, 3));
+		EXPECT_TRUE(map.insert(record, 3, 32));
+		EXPECT_EQ(*map.find(record, 3), 32);
+	}
+
+	// every thread owns the keys congruent to its index and checks its own view,
+	// while all threads race on the shared links
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t KEYS = 2000;
+	bool consistent = true;
+	std::thread threads[THREADS];
+	for (uint32_t i = 0; i < THREADS; ++i) {
+		threads[i] = std::thread {[&, i] {
+			Map::thread_record record {map};
+			for (uint32_t round = 0; round < 3; ++round) {
+				for (uint32_t key = 100 + i; key < 100 + KEYS; key += THREADS) {
+					if (!map.insert(record, key, key * 2)) {
+						consistent = false;
+					}
+				}
+				for (uint32_t key = 100 + i; key < 100 + KEYS; key += THREADS) {
+					auto value = map.find(record, key);
+					if (!value || *value != key * 2) {
+						consistent = false;
+					}
+				}
+				for (uint32_t key = 100 + i; key < 100 + KEYS; key += THREADS * 2) {
+					if (!map.remove(record, key) || map.contains(record, key)) {
+						consistent = false;
+					}
+				}
+				if (round < 2) {
+					for (uint32_t key = 100 + i + THREADS; key < 100 + KEYS; key += THREADS * 2) {
+						if (!map.remove(record, key)) {
+							consistent = false;
+						}
+					}
+				}
+			}
+		}};
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_TRUE(consistent);
+
+	Map::thread_record record {map};
+	size_t count = 0;
+	uint32_t last = 0;
+	bool ordered = true;
+	map.scan(record, 100, 100 + KEYS, [&](const uint32_t& key, const uint64_t&) {
+		ordered = ordered && key > last;
+		last = key;
+		++count;
+	});
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(count, KEYS / 2);
+}